@@ -1,9 +1,15 @@
 // execrv32i - RV32I Disassembler and Emulator
 // Usage:
 //   execrv32i dis <function.rv32i> [base_address]
-//   execrv32i emu <function.rv32i> [arg1] [arg2] ...
+//   execrv32i emu <function.rv32i> [arg1] [arg2] ... [--host-calls LIST]
+//   execrv32i bench <function.rv32i> [arg1] [arg2] ... [--iterations N] [--threads N] [--no-fusion] [--host-calls LIST] [--lanes] [--lane-args LISTS] [--pool]
+//   execrv32i membench [--iterations N]
+//   execrv32i decodebench <function.rv32i> [--iterations N]
 
 #include "argparse.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
@@ -11,12 +17,18 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "src/obf/obfuscate.h"
 #include "src/obf/restore.h"
+#include "src/rv32i/batch_rv32i.h"
 #include "src/rv32i/cpu_rv32i.h"
 #include "src/rv32i/dis_rv32i.h"
+#include "src/rv32i/host_rv32i.h"
+#include "src/rv32i/lanes_rv32i.h"
+#include "src/rv32i/pool_rv32i.h"
+#include "src/rv32i/prog_rv32i.h"
 #include "src/rv32i/regs_rv32i.h"
 
 
@@ -47,25 +59,41 @@ std::vector<std::unique_ptr<Instruction>>
 disassemble(const std::vector<uint8_t> &binary, uint32_t baseAddress = 0) {
   std::vector<std::unique_ptr<Instruction>> instructions;
 
-  // 4 byte alignment
-  if (binary.size() % 4 != 0) {
-    std::cerr << "Warning: Binary size is not a multiple of 4 bytes"
+  // 2 byte alignment (RV32C instructions are 16 bits)
+  if (binary.size() % 2 != 0) {
+    std::cerr << "Warning: Binary size is not a multiple of 2 bytes"
               << std::endl;
   }
 
-  for (size_t i = 0; i + 3 < binary.size(); i += 4) {
-    // Read 32-bit instruction in little-endian format
+  // Screen every instruction with the batch decoder first; only the ones that
+  // decode get an Instruction object for printing
+  std::vector<DecodedInst> decoded(binary.size() / 2);
+  std::vector<uint32_t> offsets(binary.size() / 2);
+  std::vector<uint8_t> status(binary.size() / 2);
+  size_t count = decodeProgram(binary.data(), binary.size(), decoded.data(),
+                               offsets.data(), status.data());
+
+  for (size_t n = 0; n < count; ++n) {
+    size_t i = offsets[n];
+    // Read the instruction in little-endian format, 16 bits if compressed
     uint32_t raw = static_cast<uint32_t>(binary[i]) |
-                   (static_cast<uint32_t>(binary[i + 1]) << 8) |
-                   (static_cast<uint32_t>(binary[i + 2]) << 16) |
-                   (static_cast<uint32_t>(binary[i + 3]) << 24);
+                   (static_cast<uint32_t>(binary[i + 1]) << 8);
+    bool compressed = isCompressed(static_cast<uint16_t>(raw));
+    if (!compressed && i + 4 <= binary.size()) {
+      raw |= (static_cast<uint32_t>(binary[i + 2]) << 16) |
+             (static_cast<uint32_t>(binary[i + 3]) << 24);
+    }
 
-    try {
-      instructions.push_back(Instruction::create(raw));
-    } catch (const std::invalid_argument &e) {
+    if (status[n] == DECODE_OK) {
+      instructions.push_back(compressed
+                                 ? Instruction::createCompressed(static_cast<uint16_t>(raw))
+                                 : Instruction::create(raw));
+    } else {
       std::cerr << "Warning at offset 0x" << std::hex << (baseAddress + i)
-                << ": " << e.what() << " (raw: 0x" << std::setfill('0')
-                << std::setw(8) << raw << ")" << std::dec << std::endl;
+                << ": "
+                << decodeStatusToString(static_cast<DECODE_STATUS>(status[n]))
+                << " (raw: 0x" << std::setfill('0') << std::setw(compressed ? 4 : 8) << raw
+                << ")" << std::dec << std::endl;
     }
   }
 
@@ -77,11 +105,15 @@ void print_disassembly(
     uint32_t baseAddress = 0, bool only_asm = false) {
   uint32_t addr = baseAddress;
   for (const auto &instr : instructions) {
+    // Compressed instructions show their 16-bit encoding and print as the
+    // instruction they expand to
+    bool compressed = instr->getLength() == 2;
     if (!only_asm) {
       std::cout << std::hex << std::setfill('0') << std::setw(8) << addr
-                << ":  " << std::setw(8) << instr->getRaw() << "  " << std::dec;
+                << ":  " << std::setw(compressed ? 4 : 8) << instr->getRaw()
+                << (compressed ? "      " : "  ") << std::dec;
     }
-    std::cout << instr->toString();
+    std::cout << (compressed ? "C." : "") << instr->toString();
 
     // Show control flow info
     if (instr->isBranch() || instr->isJump()) {
@@ -91,7 +123,7 @@ void print_disassembly(
     }
 
     std::cout << std::endl;
-    addr += 4;
+    addr += instr->getLength();
   }
 }
 
@@ -115,54 +147,509 @@ void run_disassemble(const std::string &filepath, uint32_t baseAddress,
   print_disassembly(instructions, baseAddress, only_asm);
 }
 
+// Parses up to 8 guest arguments (a0-a7); unparsable ones are passed as 0
+
+std::vector<uint32_t> parse_guest_args(const std::vector<std::string> &args) {
+  const size_t max_args = 8;
+  std::vector<uint32_t> values;
+
+  for (size_t i = 0; i < args.size() && i < max_args; ++i) {
+    uint32_t val = 0;
+    try {
+      val = std::stoul(args[i], nullptr, 0);
+    } catch (const std::exception &e) {
+      std::cerr << "Warning: Failed to parse argument '" << args[i]
+                << "': " << e.what() << "\n";
+    }
+    values.push_back(val);
+  }
+  return values;
+}
+
+// Parses per-lane guest arguments: lanes separated by ';', each lane's arguments
+// by ',' as in "27,0;6,0"
+
+std::vector<std::vector<uint32_t>> parse_lane_args(const std::string &spec) {
+  std::vector<std::vector<uint32_t>> lanes;
+  size_t start = 0;
+  while (start < spec.size()) {
+    size_t end = std::min(spec.find(';', start), spec.size());
+    std::string lane = spec.substr(start, end - start);
+    start = end + 1;
+
+    std::vector<std::string> args;
+    size_t arg_start = 0;
+    while (arg_start < lane.size()) {
+      size_t arg_end = std::min(lane.find(',', arg_start), lane.size());
+      args.push_back(lane.substr(arg_start, arg_end - arg_start));
+      arg_start = arg_end + 1;
+    }
+    lanes.push_back(parse_guest_args(args));
+  }
+  if (lanes.size() > lanes_rv32i::LANES) {
+    throw std::runtime_error("At most " + std::to_string(lanes_rv32i::LANES) +
+                             " lanes can run in lockstep");
+  }
+  return lanes;
+}
+
+// Allows the host calls in spec for prog: "all" built-in helpers, or a
+// comma-separated list of built-in names and call numbers
+
+void allow_host_calls(prog_rv32i &prog, const std::string &spec) {
+  size_t start = 0;
+  while (start <= spec.size()) {
+    size_t end = std::min(spec.find(',', start), spec.size());
+    std::string item = spec.substr(start, end - start);
+    start = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+
+    bool found = false;
+    for (uint32_t n = 0; n < HOST_FIRST_USER; ++n) {
+      const char *name = host_call_name(n);
+      if (name && (item == "all" || item == name)) {
+        prog.host_calls.set(n);
+        found = true;
+      }
+    }
+    if (!found) {
+      unsigned long number = 0;
+      try {
+        number = std::stoul(item, nullptr, 0);
+      } catch (const std::exception &) {
+        throw std::runtime_error("Unknown host call: " + item);
+      }
+      if (number >= HOST_CALL_COUNT) {
+        throw std::runtime_error("Host call number out of range: " + item);
+      }
+      prog.host_calls.set(number);
+    }
+  }
+}
+
 void run_emulate(const std::string &filepath,
-                 const std::vector<std::string> &args, bool is_obfuscated) {
+                 const std::vector<std::string> &args, bool is_obfuscated,
+                 const std::string &host_calls) {
   std::vector<uint8_t> binary = read_binary_file(filepath);
   if (is_obfuscated) {
     deobfuscate(binary);
     std::cout << "Deobfuscated input file before processing.\n";
   }
 
-  mem_rv32i::init();
+  // restore is already done above, so only decode here
+  prog_rv32i prog(binary.data(), binary.size(), false);
+  allow_host_calls(prog, host_calls);
 
-  // disassemble
-  std::vector<std::unique_ptr<Instruction>> instructions;
-  if (binary.size() % 4 != 0) {
-    throw std::runtime_error("Binary size is not a multiple of 4");
+  cpu_rv32i vm;
+  vm.load_program(prog.code);
+
+  // args are passed in a0-a7 (x10-x17)
+  std::vector<uint32_t> values = parse_guest_args(args);
+  for (size_t i = 0; i < values.size(); ++i) {
+    vm.write_reg(10 + i, values[i]);
+  }
+
+  exec_result outcome = vm.execute(prog);
+  if (outcome.reason != EXIT_RETURN) {
+    throw std::runtime_error(describe(outcome));
   }
+  uint32_t result = vm.read_reg(10); // a0
 
-  for (size_t i = 0; i < binary.size(); i += 4) {
-    uint32_t raw = 0;
-    // Little-endian load
-    raw |= binary[i];
-    raw |= (uint32_t)binary[i + 1] << 8;
-    raw |= (uint32_t)binary[i + 2] << 16;
-    raw |= (uint32_t)binary[i + 3] << 24;
+  std::cout << result << std::endl;
+}
 
-    instructions.push_back(Instruction::create(raw));
+// Times repeated calls of one prepared program, the way trampolines run it.
+// A single CPU is reused and reset between calls, as the pooled API does, and is
+// warmed up first so guest memory growth is not timed;
+// run under `perf stat` for cache-miss and instruction counts.
+
+// With --threads N it then reruns the calls from 1..N threads at once, each with
+// its own CPU and all sharing the one prepared program, and checks every result
+// against the single-threaded one. With --pool it submits them all to a
+// work-stealing pool of N workers (one per core without --threads) and waits.
+
+// With --lanes it reruns the calls in lockstep groups, every lane with the same
+// arguments; --lane-args gives each lane its own instead and checks how each one
+// stops, faults included, against a scalar call with its arguments.
+
+void run_bench(const std::string &filepath,
+               const std::vector<std::string> &args, bool is_obfuscated,
+               unsigned long iterations, const std::string &jit_threshold,
+               unsigned threads, bool fusion, const std::string &host_calls,
+               bool lanes, const std::string &lane_args, bool pool) {
+  using clock = std::chrono::steady_clock;
+  std::vector<uint8_t> binary = read_binary_file(filepath);
+
+  auto t0 = clock::now();
+  prog_rv32i prog(binary.data(), binary.size(), is_obfuscated);
+  auto t1 = clock::now();
+  if (!jit_threshold.empty()) {
+    prog.jit_threshold = std::stoul(jit_threshold, nullptr, 0);
+  }
+  if (!fusion) {
+    prog.fuse(false);
   }
+  allow_host_calls(prog, host_calls);
 
+  std::vector<uint32_t> values = parse_guest_args(args);
   cpu_rv32i vm;
-  vm.load_program(binary);
 
-  // args are passed in a0-a7 (x10-x17)
-  int arg_reg_start = 10;
-  int max_args = 8;
+  auto run_call = [&](const std::vector<uint32_t> &call_args) {
+    vm.reset();
+    vm.load_program(prog.code);
+    for (size_t i = 0; i < call_args.size(); ++i) {
+      vm.write_reg(10 + i, call_args[i]);
+    }
+    return vm.execute(prog);
+  };
+  auto call = [&]() {
+    exec_result outcome = run_call(values);
+    if (outcome.reason != EXIT_RETURN) {
+      throw std::runtime_error(describe(outcome));
+    }
+    return vm.read_reg(10);
+  };
 
-  for (size_t i = 0; i < args.size() && i < (size_t)max_args; ++i) {
-    try {
-      uint32_t val = std::stoul(args[i], nullptr, 0);
-      vm.write_reg(arg_reg_start + i, val);
-    } catch (const std::exception &e) {
-      std::cerr << "Warning: Failed to parse argument '" << args[i]
-                << "': " << e.what() << "\n";
+  // Warm-up call, not timed
+  uint32_t result = call();
+
+  auto t2 = clock::now();
+  for (unsigned long n = 0; n < iterations; ++n) {
+    result = call();
+  }
+  auto t3 = clock::now();
+
+  double prepare_us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+  double total_s = std::chrono::duration<double>(t3 - t2).count();
+
+  std::cout << "Result:     " << result << std::endl;
+  std::cout << "Prepare:    " << std::fixed << std::setprecision(2)
+            << prepare_us << " us (" << prog.instruction_count()
+            << " instructions)" << std::endl;
+  std::cout << "Execute:    " << iterations << " calls in "
+            << std::setprecision(6) << total_s << " s" << std::endl;
+  std::cout << "Per call:   " << std::setprecision(3)
+            << (iterations ? total_s * 1e6 / iterations : 0.0) << " us"
+            << std::endl;
+
+  size_t covered = 0;
+  size_t native = 0;
+  for (const block_rv32i &blk : prog.blocks) {
+    covered += blk.length;
+    native += blk.native ? 1 : 0;
+  }
+  std::cout << "Blocks:     " << prog.blocks.size() << " (avg "
+            << std::setprecision(2)
+            << (prog.blocks.empty() ? 0.0 : (double)covered / prog.blocks.size())
+            << " instructions), chain hit rate "
+            << (prog.block_transitions
+                    ? 100.0 * prog.chain_hits / prog.block_transitions
+                    : 0.0)
+            << "%, " << native << " native" << std::endl;
+  for (size_t n = 0; n < FUSION_IDIOM_COUNT; ++n) {
+    std::cout << "Fused " << std::left << std::setw(16)
+              << fusion_idiom_name(static_cast<FUSION_IDIOM>(n)) << std::right
+              << prog.fusion_sites[n] << " sites, " << prog.fusion_hits[n]
+              << " executed" << std::endl;
+  }
+
+  if (lanes || !lane_args.empty()) {
+    lanes_rv32i group;
+    constexpr size_t LANES = lanes_rv32i::LANES;
+    std::vector<std::vector<uint32_t>> per_lane = parse_lane_args(lane_args);
+    if (per_lane.empty()) {
+      // Every lane gets the same arguments, so they never diverge
+      per_lane.assign(LANES, values);
+    }
+    size_t count = per_lane.size();
+    size_t stride = 0;
+    for (const std::vector<uint32_t> &lane : per_lane) {
+      stride = std::max(stride, lane.size());
+    }
+
+    // What each lane should get, from a scalar call with its arguments
+    std::vector<uint32_t> group_args(count * stride, 0);
+    exec_result expected[LANES];
+    uint32_t expected_a0[LANES] = {};
+    for (size_t l = 0; l < count; ++l) {
+      std::copy(per_lane[l].begin(), per_lane[l].end(),
+                group_args.begin() + l * stride);
+      expected[l] = run_call(per_lane[l]);
+      if (expected[l].reason == EXIT_RETURN) {
+        expected_a0[l] = vm.read_reg(10);
+      }
+    }
+
+    uint32_t results[LANES];
+    exec_result exits[LANES];
+    unsigned long groups = (iterations + LANES - 1) / LANES;
+    if (!lane_args.empty()) {
+      groups = std::max(groups, 1UL); // at least one, to report each lane
+    }
+    unsigned long wrong = 0;
+
+    auto t4 = clock::now();
+    for (unsigned long n = 0; n < groups; ++n) {
+      group.run(prog, group_args.data(), stride, count, results, exits);
+      for (size_t l = 0; l < count; ++l) {
+        bool same = exits[l].reason == expected[l].reason &&
+                    (exits[l].reason == EXIT_RETURN
+                         ? results[l] == expected_a0[l]
+                         : exits[l].pc == expected[l].pc &&
+                               exits[l].addr == expected[l].addr);
+        wrong += same ? 0 : 1;
+      }
+    }
+    auto t5 = clock::now();
+
+    const lanes_rv32i::stats &stats = group.get_stats();
+    double elapsed = std::chrono::duration<double>(t5 - t4).count();
+    std::cout << "Lockstep:   " << std::setprecision(3)
+              << (groups ? elapsed * 1e6 / (groups * LANES) : 0.0)
+              << " us per call (" << LANES << " lanes, "
+              << lanes_rv32i::isa() << "), " << std::setprecision(1)
+              << (stats.steps ? 100.0 * stats.lane_steps / (stats.steps * LANES)
+                              : 0.0)
+              << "% lanes active, " << stats.fallbacks << " scalar fallbacks"
+              << std::endl;
+    if (!lane_args.empty()) {
+      for (size_t l = 0; l < count; ++l) {
+        std::cout << "Lane " << l << ":     "
+                  << (exits[l].reason == EXIT_RETURN
+                          ? std::to_string(results[l])
+                          : describe(exits[l]))
+                  << std::endl;
+      }
+    }
+    if (wrong) {
+      throw std::runtime_error("Lockstep calls disagreed with the scalar result");
     }
   }
 
-  vm.execute(instructions);
-  uint32_t result = vm.read_reg(10); // a0
+  double single_rate = 0.0;
+  for (unsigned t = 1; t <= threads; ++t) {
+    std::atomic<bool> go{false};
+    std::atomic<unsigned long> mismatches{0};
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < t; ++w) {
+      workers.emplace_back([&]() {
+        cpu_rv32i cpu;
+        while (!go.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        for (unsigned long n = 0; n < iterations; ++n) {
+          cpu.reset();
+          cpu.load_program(prog.code);
+          for (size_t i = 0; i < values.size(); ++i) {
+            cpu.write_reg(10 + i, values[i]);
+          }
+          if (cpu.execute(prog).reason != EXIT_RETURN ||
+              cpu.read_reg(10) != result) {
+            mismatches++;
+          }
+        }
+      });
+    }
 
-  std::cout << result << std::endl;
+    auto t4 = clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    auto t5 = clock::now();
+
+    double elapsed = std::chrono::duration<double>(t5 - t4).count();
+    double rate = elapsed > 0 ? t * iterations / elapsed : 0.0;
+    if (t == 1) {
+      single_rate = rate;
+    }
+    std::cout << "Threads " << std::setw(3) << t << ": " << std::setprecision(0)
+              << rate << " calls/s, " << std::setprecision(2)
+              << (single_rate > 0 ? rate / single_rate : 0.0) << "x";
+    if (mismatches) {
+      std::cout << ", " << mismatches << " wrong results";
+    }
+    std::cout << std::endl;
+    if (mismatches) {
+      throw std::runtime_error("Concurrent calls disagreed with the single-threaded result");
+    }
+  }
+
+  if (pool) {
+    pool_rv32i workers(threads);
+    std::vector<std::shared_ptr<pool_call>> calls(iterations);
+
+    auto t6 = clock::now();
+    for (std::shared_ptr<pool_call> &call : calls) {
+      call = std::make_shared<pool_call>();
+      call->prog = &prog;
+      std::copy(values.begin(), values.end(), call->args);
+      workers.submit(call);
+    }
+    unsigned long mismatches = 0;
+    for (std::shared_ptr<pool_call> &call : calls) {
+      call->wait();
+      if (call->failed || call->result.reason != EXIT_RETURN ||
+          static_cast<uint32_t>(call->value) != result) {
+        mismatches++;
+      }
+    }
+    auto t7 = clock::now();
+
+    uint64_t stolen = 0;
+    for (size_t k = 0; k < workers.workers(); ++k) {
+      stolen += workers.get_worker_stats(k).stolen;
+    }
+    double elapsed = std::chrono::duration<double>(t7 - t6).count();
+    std::cout << "Pool " << std::setw(3) << workers.workers()
+              << ": " << std::setprecision(0)
+              << (elapsed > 0 ? iterations / elapsed : 0.0)
+              << " calls/s, peak queue " << workers.peak_queued() << ", "
+              << stolen << " stolen" << std::endl;
+    if (mismatches) {
+      throw std::runtime_error("Pooled calls disagreed with the single-threaded result");
+    }
+  }
+}
+
+// Guest memory microbenchmark. Replays the stack traffic of an -O0 compiled
+// LW/SW-heavy function (array_swap, ptr_arithmetic: spill arguments, build a local
+// array, reload it) through mem_rv32i, once with word accesses and once assembled
+// from byte accesses, and times unaligned and page-straddling words separately.
+
+void run_membench(unsigned long iterations) {
+  using clock = std::chrono::steady_clock;
+  mem_rv32i mem;
+  uint32_t sp = mem.get_stack_ptr() - 64;
+
+  auto read_bytes = [&](uint32_t addr) {
+    return mem.read8(addr) | (mem.read8(addr + 1) << 8) |
+           (mem.read8(addr + 2) << 16) | ((uint32_t)mem.read8(addr + 3) << 24);
+  };
+  auto write_bytes = [&](uint32_t addr, uint32_t val) {
+    mem.write8(addr, val & 0xFF);
+    mem.write8(addr + 1, (val >> 8) & 0xFF);
+    mem.write8(addr + 2, (val >> 16) & 0xFF);
+    mem.write8(addr + 3, (val >> 24) & 0xFF);
+  };
+
+  // One "call": 8 stores and 12 loads against a 32-byte frame at addr
+  auto frame = [](uint32_t addr, uint32_t n, auto &&load, auto &&store) {
+    store(addr + 28, n);            // ra
+    store(addr + 24, addr + 32);    // s0
+    store(addr + 20, n);            // a0 spill
+    store(addr + 16, n ^ 0x5a5a);   // a1 spill
+    for (uint32_t slot = 0; slot < 16; slot += 4) {
+      store(addr + slot, load(addr + 20 + (slot & 4)) + slot);
+    }
+    uint32_t sum = load(addr + 8);
+    sum += load(addr + 0) ^ load(addr + 4);
+    sum += load(addr + 12);
+    sum += load(addr + 24) + load(addr + 28);
+    return sum;
+  };
+
+  auto time = [&](const char *name, uint32_t addr, auto &&load, auto &&store) {
+    uint32_t sum = 0;
+    auto t0 = clock::now();
+    for (unsigned long n = 0; n < iterations; ++n) {
+      sum += frame(addr, (uint32_t)n, load, store);
+    }
+    auto t1 = clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    double per_access = iterations ? ns / (iterations * 20.0) : 0.0;
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::fixed << std::setprecision(3) << per_access
+              << " ns/access (checksum " << sum << ")" << std::endl;
+    return per_access;
+  };
+
+  auto load_word = [&](uint32_t addr) { return mem.read32(addr); };
+  auto store_word = [&](uint32_t addr, uint32_t val) { mem.write32(addr, val); };
+
+  double words = time("Aligned words:", sp, load_word, store_word);
+  double bytes = time("Aligned bytes:", sp, read_bytes, write_bytes);
+  time("Unaligned words:", sp + 1, load_word, store_word);
+  // Frame starting 2 bytes before a page boundary, so its first slot straddles it
+  time("Page-crossing words:",
+       (sp & ~(mem_rv32i::PAGE_SIZE - 1)) - 2, load_word, store_word);
+
+  std::cout << "Speedup:                " << std::setprecision(2)
+            << (words > 0 ? bytes / words : 0.0)
+            << "x (aligned words over bytes)" << std::endl;
+}
+
+// Decoder microbenchmark. Decodes every word of a binary repeatedly with the
+// object decoder (Instruction::create), the table decoder and each batch kernel
+// the host supports, and reports words per second.
+
+void run_decodebench(const std::string &filepath, unsigned long iterations) {
+  using clock = std::chrono::steady_clock;
+  std::vector<uint8_t> binary = read_binary_file(filepath);
+  size_t count = binary.size() / 4;
+  if (count == 0) {
+    throw std::runtime_error("No instructions to decode in " + filepath);
+  }
+  std::vector<DecodedInst> out(count);
+
+  auto time = [&](const char *name, auto &&pass) {
+    uint64_t sum = 0;
+    auto t0 = clock::now();
+    for (unsigned long n = 0; n < iterations; ++n) {
+      sum += pass();
+    }
+    auto t1 = clock::now();
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+    double rate = secs > 0 ? (double)count * iterations / secs : 0.0;
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::fixed << std::setprecision(1) << rate / 1e6
+              << " M words/s (checksum " << sum << ")" << std::endl;
+    return rate;
+  };
+
+  auto word = [&](size_t i) {
+    const uint8_t *p = binary.data() + 4 * i;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  };
+
+  std::cout << "Decoding " << count << " words x " << iterations << std::endl;
+  double objects = time("Instruction objects:", [&] {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      try {
+        sum += Instruction::create(word(i))->getMnemonic();
+      } catch (const std::invalid_argument &) {
+        sum += INVALID;
+      }
+    }
+    return sum;
+  });
+  time("Table decoder:", [&] {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      decodeInstruction(word(i), out[i]);
+      sum += out[i].op;
+    }
+    return sum;
+  });
+
+  double best = 0.0;
+  for (BATCH_KERNEL kernel : {BATCH_SCALAR, BATCH_SSE41, BATCH_AVX2}) {
+    if (!batchKernelSupported(kernel)) {
+      continue;
+    }
+    std::string name = std::string("Batch (") + batchKernelToString(kernel) + "):";
+    best = std::max(best, time(name.c_str(), [&] {
+      decodeBatch(binary.data(), count, out.data(), nullptr, kernel);
+      return (uint64_t)out[count - 1].op + out[0].op;
+    }));
+  }
+
+  std::cout << "Speedup:                " << std::setprecision(2)
+            << (objects > 0 ? best / objects : 0.0)
+            << "x (best batch kernel over objects)" << std::endl;
 }
 
 void obfuscate_file(const std::string &input_path,
@@ -221,6 +708,63 @@ int main(int argc, char *argv[]) {
       .help("Deobfuscate the input file before processing")
       .default_value(false)
       .implicit_value(true);
+  emu_command.add_argument("--host-calls")
+      .help("Host calls the guest may make: all, or a list like memcpy,strlen")
+      .default_value(std::string(""));
+
+  argparse::ArgumentParser bench_command("bench");
+  bench_command.add_description(
+      "Time repeated calls of a RV32I function with optional arguments");
+  bench_command.add_argument("binary").help("Path to the RV32I binary file");
+  bench_command.add_argument("args")
+      .help("Arguments to pass to the function")
+      .remaining();
+  bench_command.add_argument("--obfuscated")
+      .help("Deobfuscate the input file before processing")
+      .default_value(false)
+      .implicit_value(true);
+  bench_command.add_argument("--iterations")
+      .help("Number of calls to time")
+      .default_value(std::string("1000"));
+  bench_command.add_argument("--jit-threshold")
+      .help("Block executions before JIT translation (0 disables, default: build setting)")
+      .default_value(std::string(""));
+  bench_command.add_argument("--no-fusion")
+      .help("Run every instruction on its own instead of fusing common pairs")
+      .default_value(false)
+      .implicit_value(true);
+  bench_command.add_argument("--threads")
+      .help("Also time concurrent calls from 1 up to N threads")
+      .default_value(std::string("0"));
+  bench_command.add_argument("--host-calls")
+      .help("Host calls the guest may make: all, or a list like memcpy,strlen")
+      .default_value(std::string(""));
+  bench_command.add_argument("--lanes")
+      .help("Also time the calls run in lockstep, several at once")
+      .default_value(false)
+      .implicit_value(true);
+  bench_command.add_argument("--lane-args")
+      .help("Run the lockstep calls with each lane's own arguments, like 27,0;6,0")
+      .default_value(std::string(""));
+  bench_command.add_argument("--pool")
+      .help("Also time the calls submitted to a worker pool")
+      .default_value(false)
+      .implicit_value(true);
+
+  argparse::ArgumentParser membench_command("membench");
+  membench_command.add_description(
+      "Time guest memory loads and stores for LW/SW-heavy code");
+  membench_command.add_argument("--iterations")
+      .help("Number of simulated calls to time")
+      .default_value(std::string("10000000"));
+
+  argparse::ArgumentParser decodebench_command("decodebench");
+  decodebench_command.add_description(
+      "Time the instruction decoders on a rv32i file");
+  decodebench_command.add_argument("binary").help("Path to the rv32i file");
+  decodebench_command.add_argument("--iterations")
+      .help("Number of passes over the file")
+      .default_value(std::string("1000"));
 
   argparse::ArgumentParser obf_command("obf");
   obf_command.add_description("Obfuscate a rv32i file");
@@ -234,6 +778,9 @@ int main(int argc, char *argv[]) {
 
   program.add_subparser(dis_command);
   program.add_subparser(emu_command);
+  program.add_subparser(bench_command);
+  program.add_subparser(membench_command);
+  program.add_subparser(decodebench_command);
   program.add_subparser(obf_command);
   program.add_subparser(deobf_command);
 
@@ -271,7 +818,66 @@ int main(int argc, char *argv[]) {
       } catch (const std::logic_error &e) {
       }
 
-      run_emulate(binary, args, obfuscated);
+      run_emulate(binary, args, obfuscated,
+                  emu_command.get<std::string>("--host-calls"));
+    } else if (program.is_subcommand_used(bench_command)) {
+      std::string binary = bench_command.get<std::string>("binary");
+      bool obfuscated = bench_command.get<bool>("--obfuscated");
+      std::string iter_str = bench_command.get<std::string>("--iterations");
+      std::string jit_threshold =
+          bench_command.get<std::string>("--jit-threshold");
+      std::string threads_str = bench_command.get<std::string>("--threads");
+      std::vector<std::string> args;
+      try {
+        args = bench_command.get<std::vector<std::string>>("args");
+      } catch (const std::logic_error &e) {
+      }
+
+      unsigned long iterations = 0;
+      try {
+        iterations = std::stoul(iter_str, nullptr, 0);
+      } catch (...) {
+        std::cerr << "Invalid iteration count: " << iter_str << std::endl;
+        return 1;
+      }
+
+      unsigned long threads = 0;
+      try {
+        threads = std::stoul(threads_str, nullptr, 0);
+      } catch (...) {
+        std::cerr << "Invalid thread count: " << threads_str << std::endl;
+        return 1;
+      }
+
+      run_bench(binary, args, obfuscated, iterations, jit_threshold, threads,
+                !bench_command.get<bool>("--no-fusion"),
+                bench_command.get<std::string>("--host-calls"),
+                bench_command.get<bool>("--lanes"),
+                bench_command.get<std::string>("--lane-args"),
+                bench_command.get<bool>("--pool"));
+    } else if (program.is_subcommand_used(membench_command)) {
+      std::string iter_str = membench_command.get<std::string>("--iterations");
+      unsigned long iterations = 0;
+      try {
+        iterations = std::stoul(iter_str, nullptr, 0);
+      } catch (...) {
+        std::cerr << "Invalid iteration count: " << iter_str << std::endl;
+        return 1;
+      }
+
+      run_membench(iterations);
+    } else if (program.is_subcommand_used(decodebench_command)) {
+      std::string binary = decodebench_command.get<std::string>("binary");
+      std::string iter_str = decodebench_command.get<std::string>("--iterations");
+      unsigned long iterations = 0;
+      try {
+        iterations = std::stoul(iter_str, nullptr, 0);
+      } catch (...) {
+        std::cerr << "Invalid iteration count: " << iter_str << std::endl;
+        return 1;
+      }
+
+      run_decodebench(binary, iterations);
     } else if (program.is_subcommand_used(obf_command)) {
       std::string input = obf_command.get<std::string>("input");
       std::string output = obf_command.get<std::string>("output");
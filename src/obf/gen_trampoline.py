@@ -4,7 +4,8 @@ gen_trampoline.py - Generate trampoline from header and bytecode
 
 Usage:
     python gen_trampoline.py --header secret.h --function secret \
-           --bytecode secret.rv32i --output trampoline_secret.c
+           --bytecode secret.rv32i --output trampoline_secret.c \
+           [--host-calls memcpy,strlen,64] [--buffer data=len*4]
 """
 
 import argparse
@@ -43,7 +44,9 @@ def parse_function_from_header(header_text: str, func_name: str):
             
             parts = param.rsplit(None, 1)
             if len(parts) == 2:
-                params.append((parts[0], parts[1]))
+                # 'const char *s' puts the stars on the name
+                name = parts[1].lstrip('*')
+                params.append((parts[0] + parts[1][:len(parts[1]) - len(name)], name))
             else:
                 m = re.match(r'(.+[*&])\s*(\w+)$', param)
                 if m:
@@ -54,35 +57,140 @@ def parse_function_from_header(header_text: str, func_name: str):
     return return_type, func_name, params
 
 
-def generate_trampoline(func_name: str, return_type: str, params: list, bytecode: bytes) -> str:
+# Built-in host calls by name, see rv32i_host_call in emulator_api.h
+HOST_CALLS = {
+    'memcpy': 'RV32I_HOST_MEMCPY',
+    'memmove': 'RV32I_HOST_MEMMOVE',
+    'memset': 'RV32I_HOST_MEMSET',
+    'memcmp': 'RV32I_HOST_MEMCMP',
+    'strlen': 'RV32I_HOST_STRLEN',
+}
+HOST_CALL_COUNT = 256
+
+
+def parse_host_calls(spec: str) -> list:
+    """Turn 'memcpy,strlen,64' into the constants/numbers to allow."""
+    calls = []
+    for item in spec.split(','):
+        item = item.strip()
+        if not item:
+            continue
+        if item in HOST_CALLS:
+            calls.append(HOST_CALLS[item])
+            continue
+        try:
+            number = int(item, 0)
+        except ValueError:
+            raise ValueError(f'unknown host call "{item}" (expected one of {", ".join(HOST_CALLS)} or a number)')
+        if not 0 <= number < HOST_CALL_COUNT:
+            raise ValueError(f'host call number {number} out of range')
+        calls.append(str(number))
+    return calls
+
+
+# Integer parameters taken as the length of a pointer parameter they follow
+LENGTH_NAME = re.compile(r'^(n|len|length|size|count|num\w*|\w*_(len|length|size|count))$')
+
+
+def parse_buffers(specs: list) -> dict:
+    """Turn ['data=len*4'] into {'data': 'len*4'}."""
+    buffers = {}
+    for spec in specs:
+        name, sep, expr = spec.partition('=')
+        if not sep or not name.strip() or not expr.strip():
+            raise ValueError(f'bad buffer "{spec}" (expected NAME=LENGTH)')
+        buffers[name.strip()] = expr.strip()
+    return buffers
+
+
+def pointer_args(params: list, buffers: dict) -> list:
+    """rv32i_arg initialisers for params, mapping every pointer to a guest buffer.
+
+    A buffer's length in bytes is its --buffer expression, else the element count in
+    a following length parameter (n, len, size, count...), else strlen + 1 for char
+    strings. const pointers are mapped read-only.
+    """
+    args = []
+    for k, (ptype, name) in enumerate(params):
+        if '*' not in ptype:
+            args.append(f'{{NULL, 0, (uint32_t){name}, 0}}')
+            continue
+        if ptype.count('*') > 1:
+            raise ValueError(f'parameter "{name}": pointers to pointers cannot be mapped')
+        elem = ' '.join(w for w in ptype.replace('*', ' ').split() if w not in ('const', 'volatile', 'restrict'))
+        size = '1' if elem == 'void' else f'sizeof({elem})'
+        nxt = params[k + 1] if k + 1 < len(params) else None
+        if name in buffers:
+            length = f'(size_t)({buffers[name]})'
+        elif nxt and '*' not in nxt[0] and LENGTH_NAME.match(nxt[1]):
+            length = f'(size_t){nxt[1]} * {size}'
+        elif elem == 'char':
+            length = f'strlen({name}) + 1'
+        else:
+            raise ValueError(f'parameter "{name}": length unknown, pass --buffer {name}=LENGTH')
+        writable = 0 if re.search(r'\bconst\b', ptype) else 1
+        args.append(f'{{(void*){name}, {length}, 0, {writable}}}')
+    return args
+
+
+def generate_trampoline(func_name: str, return_type: str, params: list, bytecode: bytes,
+                        host_calls: list = (), buffers: dict = None) -> str:
     """Generate trampoline C code."""
     
+    if len(params) > 8:
+        raise ValueError(f'{len(params)} parameters, the guest takes at most 8 in a0-a7')
     param_str = ', '.join(f'{t} {n}' for t, n in params) if params else 'void'
     
-    args = [f'(uint32_t){n}' for _, n in params]
-    args += ['0'] * (8 - len(args))
-    args_str = ', '.join(args)
-    
     bytecode_lines = []
     for i in range(0, len(bytecode), 12):
         chunk = bytecode[i:i+12]
         bytecode_lines.append('    ' + ', '.join(f'0x{b:02x}' for b in chunk) + ',')
     bytecode_arr = '\n'.join(bytecode_lines)
     
+    prog = f'__prog_{func_name}'
+    allow = ''.join(f'        rv32i_allow_host_call(fresh, {c});\n' for c in host_calls)
+    if allow:
+        allow = '        // Host calls the function may make\n' + allow
+    includes = '#include "emulator_api.h"\n'
+    if any('*' in t for t, _ in params):
+        # Pointers are mapped into the guest for the call rather than truncated
+        mapped = pointer_args(params, buffers or {})
+        table = ''.join(f'        {a},\n' for a in mapped)
+        if 'strlen(' in table:
+            includes += '#include <string.h>\n'
+        invoke = f'rv32i_invoke_args({prog}, args, {len(params)})'
+        call = f'rv32i_arg args[] = {{\n{table}    }};\n    '
+    else:
+        # The entry point of matching arity takes the arguments in host registers
+        invoke = f'rv32i_invoke{len(params)}(' + ', '.join([prog] + [f'(uint32_t){n}' for _, n in params]) + ')'
+        call = ''
     if return_type == 'void':
-        call = f'rv32i_call(__bc_{func_name}, sizeof(__bc_{func_name}), {args_str});'
+        call += f'{invoke};'
     elif return_type in ('int64_t', 'uint64_t'):
-        call = f'return ({return_type})rv32i_call64(__bc_{func_name}, sizeof(__bc_{func_name}), {args_str});'
+        call += f'return ({return_type}){invoke};'
+    elif return_type == 'uint32_t':
+        call += f'return (uint32_t){invoke};'
     else:
-        call = f'return ({return_type})rv32i_call(__bc_{func_name}, sizeof(__bc_{func_name}), {args_str});'
+        call += f'return ({return_type})(uint32_t){invoke};'
     
-    return f'''#include "emulator_api.h"
-
+    return f'''{includes}
 static const uint8_t __bc_{func_name}[] = {{
 {bytecode_arr}
 }};
 
+// Restored and decoded on first call, then shared by every thread
+static rv32i_program* {prog}_handle;
+
 {return_type} {func_name}({param_str}) {{
+    rv32i_program* {prog} = __atomic_load_n(&{prog}_handle, __ATOMIC_ACQUIRE);
+    if (!{prog}) {{
+        // Threads racing on the first call all prepare; one handle wins
+        rv32i_program* fresh = rv32i_prepare(__bc_{func_name}, sizeof(__bc_{func_name}));
+{allow}        if (__atomic_compare_exchange_n(&{prog}_handle, &{prog}, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {prog} = fresh;
+        else
+            rv32i_release(fresh);
+    }}
     {call}
 }}
 '''
@@ -94,7 +202,20 @@ def main():
     p.add_argument('--function', '-f', required=True)
     p.add_argument('--bytecode', '-b', type=Path, required=True)
     p.add_argument('--output', '-o', type=Path, required=True)
+    p.add_argument('--host-calls', default='',
+                   help='Comma-separated host calls the function may make: '
+                        f'{", ".join(HOST_CALLS)} or call numbers')
+    p.add_argument('--buffer', action='append', default=[], metavar='NAME=LENGTH',
+                   help='Byte length of pointer parameter NAME as a C expression, '
+                        'when it is not given by a following length parameter')
     args = p.parse_args()
+
+    try:
+        host_calls = parse_host_calls(args.host_calls)
+        buffers = parse_buffers(args.buffer)
+    except ValueError as e:
+        print(f'Error: {e}', file=sys.stderr)
+        sys.exit(1)
     
     if not args.header.exists():
         print(f'Error: {args.header} not found', file=sys.stderr)
@@ -110,7 +231,11 @@ def main():
         sys.exit(1)
     
     bytecode = args.bytecode.read_bytes()
-    code = generate_trampoline(name, return_type, params, bytecode)
+    try:
+        code = generate_trampoline(name, return_type, params, bytecode, host_calls, buffers)
+    except ValueError as e:
+        print(f'Error: {e}', file=sys.stderr)
+        sys.exit(1)
     args.output.write_text(code)
     
     sig = ', '.join(f'{t} {n}' for t, n in params) or 'void'
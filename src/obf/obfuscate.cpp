@@ -4,14 +4,16 @@
 
 // Obfuscation applied to every instruction
 std::vector<uint8_t> obfuscate(const std::vector<uint8_t>& data) {
-    if (data.size() % 4 != 0) {
-        throw std::runtime_error("Data size must be a multiple of 4 bytes for obfuscation");
+    // RV32C code can end in a 16-bit instruction
+    if (data.size() % 2 != 0) {
+        throw std::runtime_error("Data size must be a multiple of 2 bytes for obfuscation");
     }
 
     std::vector<uint8_t> result = data;
 
     uint32_t key = 0xDEADBEEF;
-    for (size_t i = 0; i < result.size(); i += 4) {
+    size_t i = 0;
+    for (; i + 4 <= result.size(); i += 4) {
         uint32_t word = result[i] | (result[i+1] << 8) | (result[i+2] << 16) | (result[i+3] << 24);
         word ^= key;
         result[i] = word & 0xFF;
@@ -19,6 +21,11 @@ std::vector<uint8_t> obfuscate(const std::vector<uint8_t>& data) {
         result[i+2] = (word >> 16) & 0xFF;
         result[i+3] = (word >> 24) & 0xFF;
     }
+    // A trailing halfword gets the low half of the key
+    if (i < result.size()) {
+        result[i] ^= key & 0xFF;
+        result[i+1] ^= (key >> 8) & 0xFF;
+    }
 
 // Obfuscation applied to entire binary: reverse the byte order
     std::reverse(result.begin(), result.end());
@@ -26,6 +26,10 @@ def main():
     parser.add_argument("--func-header", required=True, help="Path to target_fn.h (header)")
     parser.add_argument("--output-dir", help="Output directory (optional)")
     parser.add_argument("--output-name", required=True, help="Name of final executable")
+    parser.add_argument("--host-calls", help="Host calls the target function may make, e.g. memcpy,strlen (see rv32i_host.h)")
+    parser.add_argument("--buffer", action="append", default=[], metavar="NAME=LENGTH",
+                        help="Byte length of a pointer parameter, when no length parameter follows it (repeatable)")
+    parser.add_argument("--arch", help="RISC-V ISA for the target function, e.g. rv32i, rv32im or rv32imc_zba_zbb (default: template setting)")
 
     args = parser.parse_args()
 
@@ -41,9 +45,10 @@ def main():
     template_file = cwd / "CMakeLists.txt.template"
     emulator_lib = cwd / "libemulator_static.a"
     emulator_header = cwd / "emulator_api.h"
+    host_header = cwd / "rv32i_host.h"
 
     # Check tools
-    for tool in [execrv32i, gen_trampoline, template_file, emulator_lib, emulator_header]:
+    for tool in [execrv32i, gen_trampoline, template_file, emulator_lib, emulator_header, host_header]:
         if not tool.exists():
             print(f"Error: Required tool not found: {tool}")
             sys.exit(1)
@@ -67,6 +72,7 @@ def main():
         shutil.copy(func_header, build_dir / func_header.name)
         shutil.copy(emulator_lib, build_dir / "libemulator_static.a")
         shutil.copy(emulator_header, build_dir / "emulator_api.h")
+        shutil.copy(host_header, build_dir / "rv32i_host.h")
 
         # Instantiate CMakeLists.txt
         with open(template_file, "r") as f:
@@ -80,7 +86,10 @@ def main():
             f.write(content)
 
         print("--- Compiling Target Function ---")
-        run_command(["cmake", "."], cwd=build_dir, verbose=args.verbose)
+        cmake_configure = ["cmake", "."]
+        if args.arch:
+            cmake_configure.append(f"-DRISCV_ARCH={args.arch}")
+        run_command(cmake_configure, cwd=build_dir, verbose=args.verbose)
         run_command(["make", "compile_target_fn"], cwd=build_dir, verbose=args.verbose)
 
         print("--- Obfuscating ---")
@@ -92,11 +101,16 @@ def main():
         trampoline_src = build_dir / "trampoline.c"
         func_name = func_impl.stem
 
-        run_command([sys.executable, str(gen_trampoline),
-                     "--header", str(build_dir / func_header.name),
-                     "--function", func_name,
-                     "--bytecode", str(output_bin),
-                     "--output", str(trampoline_src)], verbose=args.verbose)
+        gen_command = [sys.executable, str(gen_trampoline),
+                       "--header", str(build_dir / func_header.name),
+                       "--function", func_name,
+                       "--bytecode", str(output_bin),
+                       "--output", str(trampoline_src)]
+        if args.host_calls:
+            gen_command += ["--host-calls", args.host_calls]
+        for buffer in args.buffer:
+            gen_command += ["--buffer", buffer]
+        run_command(gen_command, verbose=args.verbose)
 
         print("--- Linking Final Executable ---")
         # Re-run cmake to detect trampoline.c
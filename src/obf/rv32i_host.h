@@ -0,0 +1,74 @@
+#ifndef RV32I_HOST_H
+#define RV32I_HOST_H
+
+// Guest side of the emulator's host calls, for target functions. A host call is an
+// ECALL with the call number in a7 and arguments in a0-a5; the host runs it natively
+// and returns the result in a0. The trampoline has to allow every call the function
+// makes (gen_trampoline.py --host-calls), otherwise the ECALL stops the guest.
+//
+// Define RV32I_HOST_LIBC before including this to also get memcpy, memmove, memset,
+// memcmp and strlen backed by host calls, which the compiler may call on its own
+// (struct copies, zero-initialised arrays) even though target functions are linked
+// without a C library. They are kept out of the function's own .text section so the
+// target function still starts the bytecode.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Call numbers, matching rv32i_host_call in emulator_api.h
+#define RV32I_HOST_MEMCPY       1
+#define RV32I_HOST_MEMMOVE      2
+#define RV32I_HOST_MEMSET       3
+#define RV32I_HOST_MEMCMP       4
+#define RV32I_HOST_STRLEN       5
+#define RV32I_HOST_FIRST_USER   64
+
+// Wrappers are always inlined, so even at -O0 they add no functions to the bytecode
+#define RV32I_HOST_INLINE static inline __attribute__((always_inline))
+#define RV32I_HOST_LIBC_FN __attribute__((section(".text.rv32i_host")))
+
+RV32I_HOST_INLINE uint32_t rv32i_host_call(uint32_t number, uint32_t arg0, uint32_t arg1, uint32_t arg2,
+                                           uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    register uint32_t a0 __asm__("a0") = arg0;
+    register uint32_t a1 __asm__("a1") = arg1;
+    register uint32_t a2 __asm__("a2") = arg2;
+    register uint32_t a3 __asm__("a3") = arg3;
+    register uint32_t a4 __asm__("a4") = arg4;
+    register uint32_t a5 __asm__("a5") = arg5;
+    register uint32_t a7 __asm__("a7") = number;
+    __asm__ volatile("ecall"
+                     : "+r"(a0)
+                     : "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a5), "r"(a7)
+                     : "memory");
+    return a0;
+}
+
+RV32I_HOST_INLINE void* rv32i_memcpy(void* dst, const void* src, size_t n) {
+    return (void*)rv32i_host_call(RV32I_HOST_MEMCPY, (uint32_t)dst, (uint32_t)src, n, 0, 0, 0);
+}
+
+RV32I_HOST_INLINE void* rv32i_memmove(void* dst, const void* src, size_t n) {
+    return (void*)rv32i_host_call(RV32I_HOST_MEMMOVE, (uint32_t)dst, (uint32_t)src, n, 0, 0, 0);
+}
+
+RV32I_HOST_INLINE void* rv32i_memset(void* dst, int c, size_t n) {
+    return (void*)rv32i_host_call(RV32I_HOST_MEMSET, (uint32_t)dst, (uint32_t)c, n, 0, 0, 0);
+}
+
+RV32I_HOST_INLINE int rv32i_memcmp(const void* a, const void* b, size_t n) {
+    return (int)rv32i_host_call(RV32I_HOST_MEMCMP, (uint32_t)a, (uint32_t)b, n, 0, 0, 0);
+}
+
+RV32I_HOST_INLINE size_t rv32i_strlen(const char* s) {
+    return rv32i_host_call(RV32I_HOST_STRLEN, (uint32_t)s, 0, 0, 0, 0, 0);
+}
+
+#ifdef RV32I_HOST_LIBC
+RV32I_HOST_LIBC_FN void* memcpy(void* dst, const void* src, size_t n) { return rv32i_memcpy(dst, src, n); }
+RV32I_HOST_LIBC_FN void* memmove(void* dst, const void* src, size_t n) { return rv32i_memmove(dst, src, n); }
+RV32I_HOST_LIBC_FN void* memset(void* dst, int c, size_t n) { return rv32i_memset(dst, c, n); }
+RV32I_HOST_LIBC_FN int memcmp(const void* a, const void* b, size_t n) { return rv32i_memcmp(a, b, n); }
+RV32I_HOST_LIBC_FN size_t strlen(const char* s) { return rv32i_strlen(s); }
+#endif
+
+#endif // RV32I_HOST_H
@@ -0,0 +1,270 @@
+#include "batch_rv32i.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RV32I_BATCH_X86
+#include <immintrin.h>
+#endif
+
+// Scalar reference kernel: words [begin, n) of code into the same slots of f
+static void extract_scalar(const uint8_t* code, size_t begin, size_t n, FieldBatch& f) {
+    for (size_t i = begin; i < n; i++) {
+        const uint8_t* p = code + 4 * i;
+        uint32_t w = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+        int32_t s = static_cast<int32_t>(w);
+
+        f.rd[i] = (w >> 7) & 0x1F;
+        f.rs1[i] = (w >> 15) & 0x1F;
+        f.rs2[i] = (w >> 20) & 0x1F;
+        f.funct3[i] = (w >> 12) & 0x7;
+        f.funct7[i] = w >> 25;
+
+        f.immI[i] = s >> 20;
+        f.immS[i] = (s >> 25) * 32 | static_cast<int32_t>((w >> 7) & 0x1F);
+        // B: imm[12|10:5] in bits 31:25, imm[4:1|11] in bits 11:7
+        f.immB[i] = (s >> 31) * 4096 | static_cast<int32_t>(((w << 4) & 0x800) | ((w >> 20) & 0x7E0) | ((w >> 7) & 0x1E));
+        f.immU[i] = static_cast<int32_t>(w & 0xFFFFF000);
+        // J: imm[20|10:1|11|19:12] in bits 31:12
+        f.immJ[i] = (s >> 31) * (1 << 20) | static_cast<int32_t>((w & 0xFF000) | ((w >> 9) & 0x800) | ((w >> 20) & 0x7FE));
+    }
+}
+
+#ifdef RV32I_BATCH_X86
+
+// Same arithmetic as extract_scalar, eight words per step
+__attribute__((target("avx2")))
+static inline void store_low_bytes_avx2(uint8_t* dst, __m256i v) {
+    // Low byte of each 32-bit lane, gathered into the low 8 bytes
+    const __m256i pick = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pick), _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(bytes));
+}
+
+__attribute__((target("avx2")))
+static void extract_avx2(const uint8_t* code, size_t n, FieldBatch& f) {
+    const __m256i mask5 = _mm256_set1_epi32(0x1F);
+    const __m256i mask3 = _mm256_set1_epi32(0x7);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + 4 * i));
+        __m256i sign = _mm256_srai_epi32(w, 31);
+        __m256i bits11_7 = _mm256_and_si256(_mm256_srli_epi32(w, 7), mask5);
+
+        store_low_bytes_avx2(f.rd + i, bits11_7);
+        store_low_bytes_avx2(f.rs1 + i, _mm256_and_si256(_mm256_srli_epi32(w, 15), mask5));
+        store_low_bytes_avx2(f.rs2 + i, _mm256_and_si256(_mm256_srli_epi32(w, 20), mask5));
+        store_low_bytes_avx2(f.funct3 + i, _mm256_and_si256(_mm256_srli_epi32(w, 12), mask3));
+        store_low_bytes_avx2(f.funct7 + i, _mm256_srli_epi32(w, 25));
+
+        __m256i immI = _mm256_srai_epi32(w, 20);
+        __m256i immS = _mm256_or_si256(_mm256_slli_epi32(_mm256_srai_epi32(w, 25), 5), bits11_7);
+        __m256i immB = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(sign, 12),
+                            _mm256_and_si256(_mm256_slli_epi32(w, 4), _mm256_set1_epi32(0x800))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7E0)),
+                            _mm256_and_si256(_mm256_srli_epi32(w, 7), _mm256_set1_epi32(0x1E))));
+        __m256i immU = _mm256_and_si256(w, _mm256_set1_epi32(static_cast<int32_t>(0xFFFFF000)));
+        __m256i immJ = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(sign, 20),
+                            _mm256_and_si256(w, _mm256_set1_epi32(0xFF000))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 9), _mm256_set1_epi32(0x800)),
+                            _mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7FE))));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(f.immI + i), immI);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(f.immS + i), immS);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(f.immB + i), immB);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(f.immU + i), immU);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(f.immJ + i), immJ);
+    }
+    extract_scalar(code, i, n, f);
+}
+
+// Four words per step
+__attribute__((target("sse4.1")))
+static inline void store_low_bytes_sse41(uint8_t* dst, __m128i v) {
+    const __m128i pick = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    int32_t bytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, pick));
+    std::memcpy(dst, &bytes, sizeof(bytes));
+}
+
+__attribute__((target("sse4.1")))
+static void extract_sse41(const uint8_t* code, size_t n, FieldBatch& f) {
+    const __m128i mask5 = _mm_set1_epi32(0x1F);
+    const __m128i mask3 = _mm_set1_epi32(0x7);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + 4 * i));
+        __m128i sign = _mm_srai_epi32(w, 31);
+        __m128i bits11_7 = _mm_and_si128(_mm_srli_epi32(w, 7), mask5);
+
+        store_low_bytes_sse41(f.rd + i, bits11_7);
+        store_low_bytes_sse41(f.rs1 + i, _mm_and_si128(_mm_srli_epi32(w, 15), mask5));
+        store_low_bytes_sse41(f.rs2 + i, _mm_and_si128(_mm_srli_epi32(w, 20), mask5));
+        store_low_bytes_sse41(f.funct3 + i, _mm_and_si128(_mm_srli_epi32(w, 12), mask3));
+        store_low_bytes_sse41(f.funct7 + i, _mm_srli_epi32(w, 25));
+
+        __m128i immI = _mm_srai_epi32(w, 20);
+        __m128i immS = _mm_or_si128(_mm_slli_epi32(_mm_srai_epi32(w, 25), 5), bits11_7);
+        __m128i immB = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(sign, 12),
+                         _mm_and_si128(_mm_slli_epi32(w, 4), _mm_set1_epi32(0x800))),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 20), _mm_set1_epi32(0x7E0)),
+                         _mm_and_si128(_mm_srli_epi32(w, 7), _mm_set1_epi32(0x1E))));
+        __m128i immU = _mm_and_si128(w, _mm_set1_epi32(static_cast<int32_t>(0xFFFFF000)));
+        __m128i immJ = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(sign, 20),
+                         _mm_and_si128(w, _mm_set1_epi32(0xFF000))),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 9), _mm_set1_epi32(0x800)),
+                         _mm_and_si128(_mm_srli_epi32(w, 20), _mm_set1_epi32(0x7FE))));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(f.immI + i), immI);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(f.immS + i), immS);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(f.immB + i), immB);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(f.immU + i), immU);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(f.immJ + i), immJ);
+    }
+    extract_scalar(code, i, n, f);
+}
+
+#endif
+
+static BATCH_KERNEL best_kernel() {
+#ifdef RV32I_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return BATCH_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return BATCH_SSE41;
+    }
+#endif
+    return BATCH_SCALAR;
+}
+
+// Host CPU is checked once
+static BATCH_KERNEL resolve(BATCH_KERNEL kernel) {
+    static const BATCH_KERNEL best = best_kernel();
+    if (kernel == BATCH_AUTO || (kernel == BATCH_AVX2 && best != BATCH_AVX2)) {
+        return best;
+    }
+    if (kernel == BATCH_SSE41 && best == BATCH_SCALAR) {
+        return BATCH_SCALAR;
+    }
+    return kernel;
+}
+
+bool batchKernelSupported(BATCH_KERNEL kernel) {
+    return resolve(kernel) == kernel || kernel == BATCH_AUTO;
+}
+
+const char* batchKernelToString(BATCH_KERNEL kernel) {
+    switch (kernel) {
+        case BATCH_AUTO: return "auto";
+        case BATCH_SCALAR: return "scalar";
+        case BATCH_SSE41: return "SSE4.1";
+        case BATCH_AVX2: return "AVX2";
+    }
+    return "unknown";
+}
+
+void extractFields(const uint8_t* code, size_t n, FieldBatch& fields, BATCH_KERNEL kernel) noexcept {
+    n = std::min(n, FieldBatch::SIZE);
+    switch (resolve(kernel)) {
+#ifdef RV32I_BATCH_X86
+        case BATCH_AVX2:
+            extract_avx2(code, n, fields);
+            return;
+        case BATCH_SSE41:
+            extract_sse41(code, n, fields);
+            return;
+#endif
+        default:
+            extract_scalar(code, 0, n, fields);
+            return;
+    }
+}
+
+size_t decodeBatch(const uint8_t* code, size_t n, DecodedInst* out, uint8_t* status,
+                   BATCH_KERNEL kernel) noexcept {
+    FieldBatch f;
+    size_t failed = 0;
+
+    for (size_t base = 0; base < n; base += FieldBatch::SIZE) {
+        size_t count = std::min(FieldBatch::SIZE, n - base);
+        const uint8_t* words = code + 4 * base;
+        extractFields(words, count, f, kernel);
+
+        // Pass 2: mnemonic and format per word, then the fields that format uses
+        for (size_t j = 0; j < count; j++) {
+            const uint8_t* p = words + 4 * j;
+            uint32_t raw = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+            uint8_t op;
+            uint8_t format;
+            DECODE_STATUS st = decodeMnemonic(raw, op, format);
+            if (status) {
+                status[base + j] = static_cast<uint8_t>(st);
+            }
+
+            DecodedInst& d = out[base + j];
+            if (st != DECODE_OK) {
+                d = {INVALID, 0, 0, 0, 0};
+                failed++;
+                continue;
+            }
+            switch (format) {
+                case I_TYPE: d = {op, f.rd[j], f.rs1[j], 0, f.immI[j]}; break;
+                case U_TYPE: d = {op, f.rd[j], 0, 0, f.immU[j]}; break;
+                case S_TYPE: d = {op, 0, f.rs1[j], f.rs2[j], f.immS[j]}; break;
+                case R_TYPE: d = {op, f.rd[j], f.rs1[j], f.rs2[j], 0}; break;
+                case B_TYPE: d = {op, 0, f.rs1[j], f.rs2[j], f.immB[j]}; break;
+                case J_TYPE: d = {op, f.rd[j], 0, 0, f.immJ[j]}; break;
+                default: d = {op, 0, 0, 0, 0}; break;
+            }
+        }
+    }
+    return failed;
+}
+
+size_t decodeProgram(const uint8_t* code, size_t size, DecodedInst* out, uint32_t* offsets,
+                     uint8_t* status) noexcept {
+    // Instructions are gathered as 32-bit words (compressed ones expanded) and
+    // batch-decoded SIZE at a time
+    uint8_t words[4 * FieldBatch::SIZE];
+    size_t count = 0;
+    size_t pending = 0;
+    auto flush = [&]() {
+        size_t first = count - pending;
+        decodeBatch(words, pending, out + first, status ? status + first : nullptr);
+        pending = 0;
+    };
+
+    for (size_t offset = 0; offset + 2 <= size; ) {
+        uint16_t low = static_cast<uint16_t>(code[offset] | (code[offset + 1] << 8));
+        uint32_t raw;
+        offsets[count] = static_cast<uint32_t>(offset);
+        if (isCompressed(low)) {
+            raw = expandCompressed(low);
+            offset += 2;
+        } else if (offset + 4 <= size) {
+            raw = low | (code[offset + 2] << 16) | ((uint32_t)code[offset + 3] << 24);
+            offset += 4;
+        } else {
+            raw = 0;    // truncated 32-bit instruction at the end
+            offset += 2;
+        }
+        uint8_t* w = words + 4 * pending;
+        w[0] = raw & 0xFF;
+        w[1] = (raw >> 8) & 0xFF;
+        w[2] = (raw >> 16) & 0xFF;
+        w[3] = raw >> 24;
+        count++;
+        if (++pending == FieldBatch::SIZE) {
+            flush();
+        }
+    }
+    flush();
+    return count;
+}
@@ -0,0 +1,55 @@
+#ifndef BATCH_RV32I_H
+#define BATCH_RV32I_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "dis_rv32i.h"
+
+// Batch decoder. Decoding is split in two passes over blocks of words:
+//   1. a field-extraction kernel pulls rd/rs1/rs2/funct3/funct7 and all five
+//      immediate formats out of every word at once (AVX2, SSE4.1 or scalar)
+//   2. decodeMnemonic picks each word's mnemonic and format, which selects the
+//      operands and immediate that go into its DecodedInst
+// Results match decodeInstruction word for word.
+
+// Field-extraction kernel; BATCH_AUTO picks the best one the host CPU supports
+enum BATCH_KERNEL { BATCH_AUTO, BATCH_SCALAR, BATCH_SSE41, BATCH_AVX2 };
+
+// Every field of up to SIZE words, structure-of-arrays
+struct FieldBatch {
+    static constexpr size_t SIZE = 64;
+
+    uint8_t rd[SIZE];
+    uint8_t rs1[SIZE];
+    uint8_t rs2[SIZE];
+    uint8_t funct3[SIZE];
+    uint8_t funct7[SIZE];
+    int32_t immI[SIZE];
+    int32_t immS[SIZE];
+    int32_t immB[SIZE];
+    int32_t immU[SIZE];
+    int32_t immJ[SIZE];
+};
+
+// Whether the kernel can run on this CPU (BATCH_AUTO and BATCH_SCALAR always can)
+bool batchKernelSupported(BATCH_KERNEL kernel);
+const char* batchKernelToString(BATCH_KERNEL kernel);
+
+// Pass 1: extracts the fields of n <= FieldBatch::SIZE little-endian words at code
+void extractFields(const uint8_t* code, size_t n, FieldBatch& fields, BATCH_KERNEL kernel = BATCH_AUTO) noexcept;
+
+// Decodes n little-endian words at code into out. Words that don't decode become
+// INVALID; their status goes into status[i] if status is given. Returns how many
+// words failed. Never allocates or throws.
+size_t decodeBatch(const uint8_t* code, size_t n, DecodedInst* out, uint8_t* status = nullptr,
+                   BATCH_KERNEL kernel = BATCH_AUTO) noexcept;
+
+// Decodes a program that may mix 16-bit RV32C and 32-bit instructions: splits the
+// size bytes at code into instructions, expands compressed ones and batch-decodes
+// them. offsets[k] receives the byte offset of instruction k. out, offsets and
+// status (if given) need room for size / 2 entries. Returns the instruction count.
+size_t decodeProgram(const uint8_t* code, size_t size, DecodedInst* out, uint32_t* offsets,
+                     uint8_t* status = nullptr) noexcept;
+
+#endif //BATCH_RV32I_H
@@ -1,6 +1,11 @@
 #include "cpu_rv32i.h"
 
-cpu_rv32i::cpu_rv32i(): pc(0) {
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+
+cpu_rv32i::cpu_rv32i(const mem_layout& layout): pc(0), memory(layout) {
     // Initialize all registers to 0
     for (int i = 0; i < 32; i++) {
         registers[i] = 0;
@@ -12,6 +17,14 @@ cpu_rv32i::cpu_rv32i(): pc(0) {
 void cpu_rv32i::load_program(const std::vector<uint8_t> &program) {
     memory.load_code(program);
     pc = memory.get_code_base();
+    registers[1] = RETURN_SENTINEL;
+}
+
+void cpu_rv32i::reset() {
+    std::fill(std::begin(registers), std::end(registers), 0);
+    registers[2] = memory.get_stack_ptr();
+    pc = 0;
+    memory.reset();
 }
 
 uint32_t cpu_rv32i::read_reg(uint8_t reg) const {
@@ -40,301 +53,813 @@ void cpu_rv32i::branch(int32_t offset) {
 void cpu_rv32i::jump(uint32_t target) {
     pc = target;
 }
-template <typename T>
-T* as(const std::unique_ptr<Instruction>& inst) {
-    return static_cast<T*>(inst.get());
+
+std::string describe(const exec_result& result) {
+    switch (result.reason) {
+        case EXIT_RETURN: return "Returned";
+        case EXIT_PC_UNDERFLOW: return "PC out of bounds (underflow)";
+        case EXIT_PC_MISALIGNED: return "PC alignment error";
+        case EXIT_PC_OVERFLOW: return "PC out of bounds (overflow)";
+        case EXIT_ILLEGAL_INSTRUCTION: return "Illegal instruction";
+        case EXIT_ECALL: {
+            char message[64];
+            snprintf(message, sizeof(message), "Host call %u not available", result.addr);
+            return message;
+        }
+        case EXIT_EBREAK: return "EBREAK not implemented";
+        case EXIT_MEMORY_FAULT: {
+            char message[64];
+            snprintf(message, sizeof(message), "Memory access fault at 0x%08x (pc 0x%08x)", result.addr, result.pc);
+            return message;
+        }
+    }
+    return "Unknown exit reason";
 }
 
-void cpu_rv32i::execute(const std::vector<std::unique_ptr<Instruction>>& instructions) {
-    uint32_t code_base = memory.get_code_base();
+// Block transition counters, added to the program's totals when execute() exits
+struct chain_counters {
+    const prog_rv32i& prog;
+    uint64_t transitions = 0;
+    uint64_t hits = 0;
 
-    while (true) {
-        if (pc < code_base) {
-            throw std::runtime_error("PC out of bounds (underflow)");
+    explicit chain_counters(const prog_rv32i& p) : prog(p) {}
+    ~chain_counters() {
+        prog.block_transitions.fetch_add(transitions, std::memory_order_relaxed);
+        prog.chain_hits.fetch_add(hits, std::memory_order_relaxed);
+    }
+};
+
+// Fused-pair executions per idiom, added to the program's totals when execute() exits
+struct fusion_counters {
+    const prog_rv32i& prog;
+    uint64_t hits[FUSION_IDIOM_COUNT] = {};
+
+    explicit fusion_counters(const prog_rv32i& p) : prog(p) {}
+    ~fusion_counters() {
+        for (size_t n = 0; n < FUSION_IDIOM_COUNT; n++) {
+            if (hits[n]) {
+                prog.fusion_hits[n].fetch_add(hits[n], std::memory_order_relaxed);
+            }
         }
-        uint32_t offset = pc - code_base;
-        if (offset % 4 != 0) {
-            throw std::runtime_error("PC alignment error");
+    }
+};
+
+// Follows a block edge to target; only validates the pc when the link is not
+// already cached for it. Returns nullptr with trap set if target is invalid.
+static inline block_rv32i* follow(const prog_rv32i& prog, block_rv32i::link& link,
+                                  uint32_t target, uint32_t code_base, chain_counters& counters,
+                                  EXIT_REASON& trap) {
+    counters.transitions++;
+    block_rv32i* cached = link.load(std::memory_order_acquire);
+    if (cached && prog.pc_of(cached->start, code_base) == target) {
+        counters.hits++;
+        return cached;
+    }
+    size_t index;
+    if (!checked_index(prog, target, code_base, index, trap)) {
+        return nullptr;
+    }
+    cached = prog.block_at(index);
+    link.store(cached, std::memory_order_release);
+    return cached;
+}
+
+// Follows a JAL or branch edge to the instruction index resolved at predecode. The
+// target never changes, so a cached link is taken as is; out-of-range targets
+// are never linked and return nullptr with trap set.
+static inline block_rv32i* follow_static(const prog_rv32i& prog, block_rv32i::link& link,
+                                         uint32_t target, chain_counters& counters, EXIT_REASON& trap) {
+    counters.transitions++;
+    block_rv32i* cached = link.load(std::memory_order_acquire);
+    if (cached) {
+        counters.hits++;
+        return cached;
+    }
+    switch (target) {
+        case TARGET_UNDERFLOW: trap = EXIT_PC_UNDERFLOW; return nullptr;
+        case TARGET_MISALIGNED: trap = EXIT_PC_MISALIGNED; return nullptr;
+        case TARGET_OVERFLOW: trap = EXIT_PC_OVERFLOW; return nullptr;
+        default: break;
+    }
+    cached = prog.block_at(target);
+    link.store(cached, std::memory_order_release);
+    return cached;
+}
+
+// Return sites of the guest calls in progress, as instruction indices, so a RET
+// back to its caller is predicted instead of validated. Calls nested deeper than
+// SIZE overwrite the oldest entries, whose returns are then validated.
+struct return_stack {
+    static constexpr size_t SIZE = 64;
+    uint32_t entries[SIZE];
+    size_t top = 0;     // pushes so far; the newest entry is at (top - 1) % SIZE
+    size_t depth = 0;   // entries still valid
+
+    void push(size_t index) {
+        entries[top++ % SIZE] = static_cast<uint32_t>(index);
+        if (depth < SIZE) depth++;
+    }
+    size_t peek() const { return entries[(top - 1) % SIZE]; }
+    void pop() { top--; depth--; }
+    void clear() { depth = 0; }
+};
+
+// Returned by enter() when native code returned to the host or jumped somewhere invalid
+static constexpr size_t TRAPPED = SIZE_MAX;
+
+// Enters blk. Hot blocks run as native code (translated once they cross the JIT
+// threshold), following their exits until reaching a block the interpreter has to
+// run; returns the instruction index to dispatch at, or TRAPPED with result filled
+// in. Native code sets site to each load or store it runs, for fault reporting.
+static inline size_t enter(const prog_rv32i& prog, block_rv32i*& blk, uint32_t* regs, mem_rv32i& mem,
+                           uint32_t code_base, chain_counters& counters, return_stack& calls,
+                           exec_result& result, size_t& site) {
+#ifdef RV32I_JIT_X86_64
+    while (native_block_fn native = prog.native_code(blk, code_base)) {
+        uint32_t next = native(regs, &mem, &site);
+        if (blk->native_length < blk->length) {
+            // Native code stopped short of the terminator, interpret the rest
+            return blk->start + blk->native_length;
         }
-        size_t index = offset / 4;
 
-        if (index >= instructions.size()) {
-            throw std::runtime_error("PC out of bounds (overflow)");
+        size_t last_index = blk->start + blk->length - 1;
+        const DecodedInst& last_inst = prog.decoded[last_index];
+        uint8_t last = last_inst.op;
+        if ((last == JAL || last == JALR) && last_inst.rd == 1) {
+            calls.push(last_index + 1);
+        }
+        if (next == cpu_rv32i::RETURN_SENTINEL) {
+            // A JALR returned to the host
+            result.reason = EXIT_RETURN;
+            result.pc = prog.pc_of(last_index, code_base);
+            result.addr = 0;
+            return TRAPPED;
         }
+        bool conditional = last == BEQ || last == BNE || last == BLT || last == BGE || last == BLTU || last == BGEU;
+        uint32_t fall_pc = prog.pc_of(last_index + 1, code_base);
+        block_rv32i* to;
+        if (conditional && next == fall_pc) {
+            to = follow(prog, blk->next, next, code_base, counters, result.reason);
+        } else {
+            to = follow(prog, blk->taken, next, code_base, counters, result.reason);
+        }
+        if (!to) {
+            result.pc = prog.pc_of(last_index, code_base);  // the terminator that jumped
+            result.addr = next;
+            return TRAPPED;
+        }
+        blk = to;
+    }
+#else
+    (void)prog;
+    (void)regs;
+    (void)mem;
+    (void)code_base;
+    (void)counters;
+    (void)calls;
+    (void)result;
+    (void)site;
+#endif
+    return blk->start;
+}
+
+// Both dispatch engines share the operation bodies below and differ only in
+// how they get from one instruction to the next:
+//   switch   - a loop that switches on the dispatch op (portable)
+//   threaded - direct-threaded code: each instruction's handler address is resolved
+//              once per program and every handler jumps straight to the next one
+//              via computed goto (GCC/Clang only, RV32I_THREADED_DISPATCH)
+// Execution walks basic blocks: straight-line instructions just advance the index,
+// and leaving a block goes through its cached successor links (see follow()) and
+// enter(), which hands hot blocks to the JIT.
+// Inside a body, `i` is the current instruction, PC its address and NEXT_PC the
+// address after it (instructions are 2 or 4 bytes long); bodies end in
+// NEXT (next instruction in the block), BRANCH (taken edge of a JAL or branch, to
+// its predecoded target), JUMP(target) (JALR edge to a pc checked at run time),
+// FALLTHROUGH (not-taken edge), STOP (return to the host) or EXIT (a trap).
+// Calls through ra push their return site onto `calls`, and RET takes it from
+// there when it matches; returning to RETURN_SENTINEL stops.
+// Guest faults are returned as an exec_result, never thrown.
+// Dispatch goes by prog.ops rather than the mnemonic, so a fused pair (FUSED_OP)
+// runs as one body: `j` is its second instruction, and the body steps `index` onto
+// it before a jump or branch so PC and the branch target are the second's.
+exec_result cpu_rv32i::run(const prog_rv32i& prog) noexcept {
+    const std::vector<DecodedInst>& instructions = prog.decoded;
+    uint32_t code_base = memory.get_code_base();
+
+    chain_counters counters(prog);
+    fusion_counters fused(prog);
+    return_stack calls;
+    const uint32_t* targets = prog.targets.data();
+    const uint32_t* offsets = prog.offsets.data();
+    exec_result result;
+    EXIT_REASON trap = EXIT_PC_OVERFLOW; // set by follow() whenever it fails
+    size_t index;
+    const DecodedInst* i;
+#ifdef RV32I_RESERVED_MEMORY
+    size_t& site = fault_index;
+    // Records the current instruction before an access that may fault
+    #define MEM_SITE    { site = index; std::atomic_signal_fence(std::memory_order_seq_cst); }
+#else
+    size_t site = 0;
+    #define MEM_SITE
+#endif
+
+    #define PC          (code_base + offsets[index])
+    #define NEXT_PC     (code_base + offsets[index + 1])
+    #define EXIT(r, at, a) { pc = (at); result.reason = (r); result.pc = pc; result.addr = (a); return result; }
+    #define ENTER       { index = enter(prog, blk, registers, memory, code_base, counters, calls, result, site); \
+                          if (index == TRAPPED) { pc = result.pc; return result; } DISPATCH; }
+    #define EDGE(l, t)  { uint32_t to_pc = (t); block_rv32i* to = follow(prog, blk->l, to_pc, code_base, counters, trap); \
+                          if (!to) EXIT(trap, PC, to_pc); blk = to; ENTER; }
+    #define JUMP(t)     { if ((t) == RETURN_SENTINEL) STOP; EDGE(taken, t) }
+    #define CALL        { if (i->rd == 1) calls.push(index + 1); }
+    #define STATIC_EDGE(l, n) { block_rv32i* to = follow_static(prog, blk->l, (n), counters, trap); \
+                          if (!to) EXIT(trap, PC, PC + instructions[index].imm); blk = to; ENTER; }
+    #define BRANCH      STATIC_EDGE(taken, targets[index])
+    #define FALLTHROUGH STATIC_EDGE(next, static_cast<uint32_t>(index + 1))
+    #define STOP        EXIT(EXIT_RETURN, PC, 0)
+
+    if (!checked_index(prog, pc, code_base, index, trap)) {
+        EXIT(trap, pc, pc);
+    }
+    block_rv32i* blk = prog.block_at(index);
+
+#ifdef RV32I_THREADED_DISPATCH
+    // Handler per dispatch op, must follow MNEMONIC then FUSED_OP order
+    static const void* const labels[] = {
+        &&op_LUI, &&op_AUIPC,
+        &&op_JALR, &&op_LB, &&op_LH, &&op_LW, &&op_LBU, &&op_LHU, &&op_ADDI, &&op_SLTI, &&op_SLTIU,
+        &&op_XORI, &&op_ORI, &&op_ANDI,
+        &&op_SB, &&op_SH, &&op_SW,
+        &&op_SLLI, &&op_SRLI, &&op_SRAI,
+        &&op_ADD, &&op_SUB, &&op_SLL, &&op_SLT, &&op_SLTU, &&op_XOR, &&op_SRL, &&op_SRA, &&op_OR, &&op_AND,
+        &&op_MUL, &&op_MULH, &&op_MULHSU, &&op_MULHU, &&op_DIV, &&op_DIVU, &&op_REM, &&op_REMU,
+        &&op_SH1ADD, &&op_SH2ADD, &&op_SH3ADD,
+        &&op_ANDN, &&op_ORN, &&op_XNOR, &&op_MIN, &&op_MINU, &&op_MAX, &&op_MAXU, &&op_ROL, &&op_ROR,
+        &&op_ZEXT_H,
+        &&op_CLZ, &&op_CTZ, &&op_CPOP, &&op_SEXT_B, &&op_SEXT_H, &&op_RORI, &&op_ORC_B, &&op_REV8,
+        &&op_BEQ, &&op_BNE, &&op_BLT, &&op_BGE, &&op_BLTU, &&op_BGEU,
+        &&op_JAL,
+        &&op_RET,
+        &&op_FENCE, &&op_FENCE_TSO, &&op_PAUSE,
+        &&op_ECALL, &&op_EBREAK,
+        &&op_INVALID,
+        &&op_FUSED_LUI_ADDI, &&op_FUSED_AUIPC_JALR,
+        &&op_FUSED_LW_ADDI, &&op_FUSED_LW_ADD, &&op_FUSED_LW_SUB,
+        &&op_FUSED_SLT_BEQ, &&op_FUSED_SLT_BNE, &&op_FUSED_SLTU_BEQ, &&op_FUSED_SLTU_BNE
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == DISPATCH_OP_COUNT,
+                  "dispatch table out of sync with MNEMONIC/FUSED_OP");
+
+    // Resolve handler addresses once per program
+    std::call_once(prog.handlers_once, [&]() {
+        prog.handlers.resize(instructions.size());
+        for (size_t n = 0; n < instructions.size(); n++) {
+            prog.handlers[n] = labels[prog.ops[n]];
+        }
+    });
+
+    const DecodedInst* base = instructions.data();
+    const void* const* handlers = prog.handlers.data();
+
+    #define OP(m)       op_##m:
+    #define DISPATCH    { i = &base[index]; goto *handlers[index]; }
+    #define NEXT        { ++index; DISPATCH; }
+    #define NEXT2       { index += 2; DISPATCH; }
 
-        const auto& inst = instructions[index];
-        MNEMONIC m = inst->getMnemonic();
+    ENTER;
+#else
+    #define OP(m)       case m:
+    #define DISPATCH    continue
+    #define NEXT        { ++index; continue; }
+    #define NEXT2       { index += 2; continue; }
 
-        // Default next PC
-        uint32_t next_pc = pc + 4;
-        bool branch_taken = false;
+    const uint8_t* ops = prog.ops.data();
+    index = enter(prog, blk, registers, memory, code_base, counters, calls, result, site);
+    if (index == TRAPPED) {
+        pc = result.pc;
+        return result;
+    }
+    while (true) {
+        i = &instructions[index];
 
-        switch (m) {
+        switch (ops[index]) {
+#endif
             // ---------------- U-Type ----------------
-            case LUI: { // Load Upper Immediate
-                auto* i = as<UType>(inst);
+            OP(LUI) { // Load Upper Immediate
                 write_reg(i->rd, i->imm);
-                break;
+                NEXT;
             }
-            case AUIPC: { // Add Upper Immediate to PC
-                auto* i = as<UType>(inst);
-                write_reg(i->rd, pc + i->imm);
-                break;
+            OP(AUIPC) { // Add Upper Immediate to PC
+                write_reg(i->rd, PC + i->imm);
+                NEXT;
             }
 
             // ---------------- J-Type ----------------
-            case JAL: { // Jump and Link
-                auto* i = as<JType>(inst);
-                write_reg(i->rd, pc + 4);
-                next_pc = pc + i->imm;
-                branch_taken = true;
-                break;
+            OP(JAL) { // Jump and Link
+                write_reg(i->rd, NEXT_PC);
+                CALL;
+                BRANCH;
             }
 
             // ---------------- I-Type (Jumps) ----------------
-            case JALR: { // Jump and Link Register
-                auto* i = as<IType>(inst);
+            OP(JALR) { // Jump and Link Register
                 uint32_t target = read_reg(i->rs1) + i->imm;
                 target &= ~1; // Clear LSB
-                write_reg(i->rd, pc + 4);
-                next_pc = target;
-                branch_taken = true;
-                break;
-            }
-            case RET: { // Pseudo-instruction for JALR x0, x1, 0
-                // Stop execution and return
-                return;
+                write_reg(i->rd, NEXT_PC);
+                CALL;
+                JUMP(target);
+            }
+            OP(RET) { // Pseudo-instruction for JALR x0, x1, 0
+                uint32_t target = read_reg(1) & ~1u;
+                if (calls.depth && code_base + offsets[calls.peek()] == target) {
+                    // Back to the caller that pushed it: the site is known valid
+                    counters.transitions++;
+                    counters.hits++;
+                    blk = prog.block_at(calls.peek());
+                    calls.pop();
+                    ENTER;
+                }
+                // Unmatched return (stack overflowed or unwound by hand): resync
+                calls.clear();
+                JUMP(target);
             }
 
             // ---------------- B-Type (Branches) ----------------
-            case BEQ: {
-                auto* i = as<BType>(inst);
+            OP(BEQ) {
                 if (read_reg(i->rs1) == read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
-            case BNE: {
-                auto* i = as<BType>(inst);
+            OP(BNE) {
                 if (read_reg(i->rs1) != read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
-            case BLT: {
-                auto* i = as<BType>(inst);
+            OP(BLT) {
                 if ((int32_t)read_reg(i->rs1) < (int32_t)read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
-            case BGE: {
-                auto* i = as<BType>(inst);
+            OP(BGE) {
                 if ((int32_t)read_reg(i->rs1) >= (int32_t)read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
-            case BLTU: {
-                auto* i = as<BType>(inst);
+            OP(BLTU) {
                 if (read_reg(i->rs1) < read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
-            case BGEU: {
-                auto* i = as<BType>(inst);
+            OP(BGEU) {
                 if (read_reg(i->rs1) >= read_reg(i->rs2)) {
-                    next_pc = pc + i->imm;
-                    branch_taken = true;
+                    BRANCH;
                 }
-                break;
+                FALLTHROUGH;
             }
 
             // ---------------- I-Type (Loads) ----------------
-            case LB: {
-                auto* i = as<IType>(inst);
+            OP(LB) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 int8_t val = (int8_t)memory.read8(addr);
                 write_reg(i->rd, (int32_t)val);
-                break;
+                NEXT;
             }
-            case LH: {
-                auto* i = as<IType>(inst);
+            OP(LH) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 int16_t val = (int16_t)memory.read16(addr);
                 write_reg(i->rd, (int32_t)val);
-                break;
+                NEXT;
             }
-            case LW: {
-                auto* i = as<IType>(inst);
+            OP(LW) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 uint32_t val = memory.read32(addr);
                 write_reg(i->rd, val);
-                break;
+                NEXT;
             }
-            case LBU: {
-                auto* i = as<IType>(inst);
+            OP(LBU) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 uint8_t val = memory.read8(addr);
                 write_reg(i->rd, val);
-                break;
+                NEXT;
             }
-            case LHU: {
-                auto* i = as<IType>(inst);
+            OP(LHU) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 uint16_t val = memory.read16(addr);
                 write_reg(i->rd, val);
-                break;
+                NEXT;
             }
 
             // ---------------- S-Type (Stores) ----------------
-            case SB: {
-                auto* i = as<SType>(inst);
+            OP(SB) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 memory.write8(addr, (uint8_t)read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case SH: {
-                auto* i = as<SType>(inst);
+            OP(SH) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 memory.write16(addr, (uint16_t)read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case SW: {
-                auto* i = as<SType>(inst);
+            OP(SW) {
+                MEM_SITE;
                 uint32_t addr = read_reg(i->rs1) + i->imm;
                 memory.write32(addr, read_reg(i->rs2));
-                break;
+                NEXT;
             }
 
             // ---------------- I-Type (ALU Immediates) ----------------
-            case ADDI: {
-                auto* i = as<IType>(inst);
+            OP(ADDI) {
                 write_reg(i->rd, read_reg(i->rs1) + i->imm);
-                break;
+                NEXT;
             }
-            case SLTI: {
-                auto* i = as<IType>(inst);
+            OP(SLTI) {
                 write_reg(i->rd, ((int32_t)read_reg(i->rs1) < i->imm) ? 1 : 0);
-                break;
+                NEXT;
             }
-            case SLTIU: {
-                auto* i = as<IType>(inst);
+            OP(SLTIU) {
                 write_reg(i->rd, (read_reg(i->rs1) < (uint32_t)i->imm) ? 1 : 0);
-                break;
+                NEXT;
             }
-            case XORI: {
-                auto* i = as<IType>(inst);
+            OP(XORI) {
                 write_reg(i->rd, read_reg(i->rs1) ^ i->imm);
-                break;
+                NEXT;
             }
-            case ORI: {
-                auto* i = as<IType>(inst);
+            OP(ORI) {
                 write_reg(i->rd, read_reg(i->rs1) | i->imm);
-                break;
+                NEXT;
             }
-            case ANDI: {
-                auto* i = as<IType>(inst);
+            OP(ANDI) {
                 write_reg(i->rd, read_reg(i->rs1) & i->imm);
-                break;
+                NEXT;
             }
-            case SLLI: {
-                auto* i = as<IType>(inst);
+            OP(SLLI) {
                 // shamt is lower 5 bits of imm
                 uint32_t shamt = i->imm & 0x1F;
                 write_reg(i->rd, read_reg(i->rs1) << shamt);
-                break;
+                NEXT;
             }
-            case SRLI: {
-                auto* i = as<IType>(inst);
+            OP(SRLI) {
                 uint32_t shamt = i->imm & 0x1F;
                 write_reg(i->rd, read_reg(i->rs1) >> shamt);
-                break;
+                NEXT;
             }
-            case SRAI: {
-                auto* i = as<IType>(inst);
+            OP(SRAI) {
                 uint32_t shamt = i->imm & 0x1F;
                 int32_t val = (int32_t)read_reg(i->rs1);
                 write_reg(i->rd, (uint32_t)(val >> shamt));
-                break;
+                NEXT;
             }
 
             // ---------------- R-Type (ALU Register) ----------------
-            case ADD: {
-                auto* i = as<RType>(inst);
+            OP(ADD) {
                 write_reg(i->rd, read_reg(i->rs1) + read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case SUB: {
-                auto* i = as<RType>(inst);
+            OP(SUB) {
                 write_reg(i->rd, read_reg(i->rs1) - read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case SLL: {
-                auto* i = as<RType>(inst);
+            OP(SLL) {
                 uint32_t shamt = read_reg(i->rs2) & 0x1F;
                 write_reg(i->rd, read_reg(i->rs1) << shamt);
-                break;
+                NEXT;
             }
-            case SLT: {
-                auto* i = as<RType>(inst);
+            OP(SLT) {
                 write_reg(i->rd, ((int32_t)read_reg(i->rs1) < (int32_t)read_reg(i->rs2)) ? 1 : 0);
-                break;
+                NEXT;
             }
-            case SLTU: {
-                auto* i = as<RType>(inst);
+            OP(SLTU) {
                 write_reg(i->rd, (read_reg(i->rs1) < read_reg(i->rs2)) ? 1 : 0);
-                break;
+                NEXT;
             }
-            case XOR: {
-                auto* i = as<RType>(inst);
+            OP(XOR) {
                 write_reg(i->rd, read_reg(i->rs1) ^ read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case SRL: {
-                auto* i = as<RType>(inst);
+            OP(SRL) {
                 uint32_t shamt = read_reg(i->rs2) & 0x1F;
                 write_reg(i->rd, read_reg(i->rs1) >> shamt);
-                break;
+                NEXT;
             }
-            case SRA: {
-                auto* i = as<RType>(inst);
+            OP(SRA) {
                 uint32_t shamt = read_reg(i->rs2) & 0x1F;
                 int32_t val = (int32_t)read_reg(i->rs1);
                 write_reg(i->rd, (uint32_t)(val >> shamt));
-                break;
+                NEXT;
             }
-            case OR: {
-                auto* i = as<RType>(inst);
+            OP(OR) {
                 write_reg(i->rd, read_reg(i->rs1) | read_reg(i->rs2));
-                break;
+                NEXT;
             }
-            case AND: {
-                auto* i = as<RType>(inst);
+            OP(AND) {
                 write_reg(i->rd, read_reg(i->rs1) & read_reg(i->rs2));
-                break;
+                NEXT;
+            }
+
+            // ---------------- R-Type (RV32M) ----------------
+            OP(MUL) {
+                write_reg(i->rd, read_reg(i->rs1) * read_reg(i->rs2));
+                NEXT;
+            }
+            OP(MULH) {
+                int64_t product = (int64_t)(int32_t)read_reg(i->rs1) * (int32_t)read_reg(i->rs2);
+                write_reg(i->rd, (uint32_t)((uint64_t)product >> 32));
+                NEXT;
+            }
+            OP(MULHSU) {
+                int64_t product = (int64_t)(int32_t)read_reg(i->rs1) * (int64_t)read_reg(i->rs2);
+                write_reg(i->rd, (uint32_t)((uint64_t)product >> 32));
+                NEXT;
+            }
+            OP(MULHU) {
+                uint64_t product = (uint64_t)read_reg(i->rs1) * read_reg(i->rs2);
+                write_reg(i->rd, (uint32_t)(product >> 32));
+                NEXT;
+            }
+            // Division never traps: x/0 is all ones (DIV, DIVU) or x (REM, REMU), and
+            // INT32_MIN / -1 overflows to INT32_MIN with remainder 0
+            OP(DIV) {
+                int32_t a = (int32_t)read_reg(i->rs1);
+                int32_t b = (int32_t)read_reg(i->rs2);
+                uint32_t q = b == 0 ? UINT32_MAX
+                           : (a == INT32_MIN && b == -1) ? (uint32_t)INT32_MIN
+                           : (uint32_t)(a / b);
+                write_reg(i->rd, q);
+                NEXT;
+            }
+            OP(DIVU) {
+                uint32_t b = read_reg(i->rs2);
+                write_reg(i->rd, b == 0 ? UINT32_MAX : read_reg(i->rs1) / b);
+                NEXT;
+            }
+            OP(REM) {
+                int32_t a = (int32_t)read_reg(i->rs1);
+                int32_t b = (int32_t)read_reg(i->rs2);
+                uint32_t r = b == 0 ? (uint32_t)a
+                           : (a == INT32_MIN && b == -1) ? 0
+                           : (uint32_t)(a % b);
+                write_reg(i->rd, r);
+                NEXT;
+            }
+            OP(REMU) {
+                uint32_t a = read_reg(i->rs1);
+                uint32_t b = read_reg(i->rs2);
+                write_reg(i->rd, b == 0 ? a : a % b);
+                NEXT;
+            }
+
+            // ---------------- Zba (shift-and-add) ----------------
+            OP(SH1ADD) {
+                write_reg(i->rd, (read_reg(i->rs1) << 1) + read_reg(i->rs2));
+                NEXT;
+            }
+            OP(SH2ADD) {
+                write_reg(i->rd, (read_reg(i->rs1) << 2) + read_reg(i->rs2));
+                NEXT;
+            }
+            OP(SH3ADD) {
+                write_reg(i->rd, (read_reg(i->rs1) << 3) + read_reg(i->rs2));
+                NEXT;
+            }
+
+            // ---------------- Zbb (basic bit manipulation) ----------------
+            OP(ANDN) {
+                write_reg(i->rd, read_reg(i->rs1) & ~read_reg(i->rs2));
+                NEXT;
+            }
+            OP(ORN) {
+                write_reg(i->rd, read_reg(i->rs1) | ~read_reg(i->rs2));
+                NEXT;
+            }
+            OP(XNOR) {
+                write_reg(i->rd, ~(read_reg(i->rs1) ^ read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(MIN) {
+                write_reg(i->rd, (uint32_t)std::min((int32_t)read_reg(i->rs1), (int32_t)read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(MINU) {
+                write_reg(i->rd, std::min(read_reg(i->rs1), read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(MAX) {
+                write_reg(i->rd, (uint32_t)std::max((int32_t)read_reg(i->rs1), (int32_t)read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(MAXU) {
+                write_reg(i->rd, std::max(read_reg(i->rs1), read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(ROL) {
+                write_reg(i->rd, rotl32(read_reg(i->rs1), read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(ROR) {
+                write_reg(i->rd, rotr32(read_reg(i->rs1), read_reg(i->rs2)));
+                NEXT;
+            }
+            OP(ZEXT_H) {
+                write_reg(i->rd, read_reg(i->rs1) & 0xFFFF);
+                NEXT;
+            }
+            OP(CLZ) {
+                uint32_t val = read_reg(i->rs1);
+                write_reg(i->rd, val ? __builtin_clz(val) : 32);
+                NEXT;
+            }
+            OP(CTZ) {
+                uint32_t val = read_reg(i->rs1);
+                write_reg(i->rd, val ? __builtin_ctz(val) : 32);
+                NEXT;
+            }
+            OP(CPOP) {
+                write_reg(i->rd, __builtin_popcount(read_reg(i->rs1)));
+                NEXT;
+            }
+            OP(SEXT_B) {
+                write_reg(i->rd, (uint32_t)(int32_t)(int8_t)read_reg(i->rs1));
+                NEXT;
+            }
+            OP(SEXT_H) {
+                write_reg(i->rd, (uint32_t)(int32_t)(int16_t)read_reg(i->rs1));
+                NEXT;
+            }
+            OP(RORI) {
+                write_reg(i->rd, rotr32(read_reg(i->rs1), i->imm & 0x1F));
+                NEXT;
+            }
+            OP(ORC_B) {
+                write_reg(i->rd, orc_b(read_reg(i->rs1)));
+                NEXT;
+            }
+            OP(REV8) {
+                write_reg(i->rd, __builtin_bswap32(read_reg(i->rs1)));
+                NEXT;
             }
 
             // Unimplemented
-            case FENCE:
-            case FENCE_TSO:
-            case PAUSE:
-                break;
+            OP(FENCE)
+            OP(FENCE_TSO)
+            OP(PAUSE)
+                NEXT;
 
-            case ECALL:
-            case EBREAK:
-                throw std::runtime_error("ECALL/EBREAK not implemented");
+            // Host call: the number is in a7, and the call may touch guest memory
+            OP(ECALL) {
+                uint32_t number = registers[17];
+                MEM_SITE;
+                if (number >= HOST_CALL_COUNT || !prog.host_calls[number] || !run_host_call(*this, number)) {
+                    EXIT(EXIT_ECALL, PC, number);
+                }
+                FALLTHROUGH;
+            }
+            OP(EBREAK)
+                EXIT(EXIT_EBREAK, PC, 0);
+
+            // Stop word placed after the last instruction
+            OP(INVALID)
+                // Either the stop word past the end, or a word that didn't decode
+                if (index + 1 == instructions.size()) {
+                    EXIT(EXIT_PC_OVERFLOW, PC, PC);
+                }
+                EXIT(EXIT_ILLEGAL_INSTRUCTION, PC, 0);
 
+            // ---------------- Fused pairs ----------------
+            OP(FUSED_LUI_ADDI) {
+                const DecodedInst* j = i + 1;
+                fused.hits[FUSION_LUI_ADDI]++;
+                write_reg(i->rd, i->imm);
+                write_reg(j->rd, read_reg(j->rs1) + j->imm);
+                NEXT2;
+            }
+            OP(FUSED_AUIPC_JALR) {
+                const DecodedInst* j = i + 1;
+                fused.hits[FUSION_AUIPC_JALR]++;
+                write_reg(i->rd, PC + i->imm);
+                ++index;
+                uint32_t target = (read_reg(j->rs1) + j->imm) & ~1u;
+                write_reg(j->rd, NEXT_PC);
+                if (j->rd == 1) calls.push(index + 1);
+                JUMP(target);
+            }
+            OP(FUSED_LW_ADDI) {
+                const DecodedInst* j = i + 1;
+                MEM_SITE;
+                fused.hits[FUSION_LOAD_ALU]++;
+                write_reg(i->rd, memory.read32(read_reg(i->rs1) + i->imm));
+                write_reg(j->rd, read_reg(j->rs1) + j->imm);
+                NEXT2;
+            }
+            OP(FUSED_LW_ADD) {
+                const DecodedInst* j = i + 1;
+                MEM_SITE;
+                fused.hits[FUSION_LOAD_ALU]++;
+                write_reg(i->rd, memory.read32(read_reg(i->rs1) + i->imm));
+                write_reg(j->rd, read_reg(j->rs1) + read_reg(j->rs2));
+                NEXT2;
+            }
+            OP(FUSED_LW_SUB) {
+                const DecodedInst* j = i + 1;
+                MEM_SITE;
+                fused.hits[FUSION_LOAD_ALU]++;
+                write_reg(i->rd, memory.read32(read_reg(i->rs1) + i->imm));
+                write_reg(j->rd, read_reg(j->rs1) - read_reg(j->rs2));
+                NEXT2;
+            }
+            // The branch tests the comparison result against x0
+            OP(FUSED_SLT_BEQ) {
+                fused.hits[FUSION_COMPARE_BRANCH]++;
+                uint32_t less = (int32_t)read_reg(i->rs1) < (int32_t)read_reg(i->rs2);
+                write_reg(i->rd, less);
+                ++index;
+                if (!less) {
+                    BRANCH;
+                }
+                FALLTHROUGH;
+            }
+            OP(FUSED_SLT_BNE) {
+                fused.hits[FUSION_COMPARE_BRANCH]++;
+                uint32_t less = (int32_t)read_reg(i->rs1) < (int32_t)read_reg(i->rs2);
+                write_reg(i->rd, less);
+                ++index;
+                if (less) {
+                    BRANCH;
+                }
+                FALLTHROUGH;
+            }
+            OP(FUSED_SLTU_BEQ) {
+                fused.hits[FUSION_COMPARE_BRANCH]++;
+                uint32_t less = read_reg(i->rs1) < read_reg(i->rs2);
+                write_reg(i->rd, less);
+                ++index;
+                if (!less) {
+                    BRANCH;
+                }
+                FALLTHROUGH;
+            }
+            OP(FUSED_SLTU_BNE) {
+                fused.hits[FUSION_COMPARE_BRANCH]++;
+                uint32_t less = read_reg(i->rs1) < read_reg(i->rs2);
+                write_reg(i->rd, less);
+                ++index;
+                if (less) {
+                    BRANCH;
+                }
+                FALLTHROUGH;
+            }
+
+#ifndef RV32I_THREADED_DISPATCH
             default:
-                throw std::runtime_error("Unknown instruction mnemonic");
+                EXIT(EXIT_ILLEGAL_INSTRUCTION, PC, 0);
         }
+    }
+#endif
+
+    #undef OP
+    #undef PC
+    #undef NEXT_PC
+    #undef DISPATCH
+    #undef NEXT
+    #undef NEXT2
+    #undef ENTER
+    #undef EDGE
+    #undef CALL
+    #undef JUMP
+    #undef STATIC_EDGE
+    #undef BRANCH
+    #undef FALLTHROUGH
+    #undef STOP
+    #undef EXIT
+    #undef MEM_SITE
+}
 
-        pc = next_pc;
+exec_result cpu_rv32i::execute(const prog_rv32i& prog) noexcept {
+#ifdef RV32I_RESERVED_MEMORY
+    // Guest accesses are unchecked host accesses into the reservation; one that
+    // lands outside the committed regions comes back here as a guest fault
+    mem_rv32i::fault_scope scope(memory);
+    if (sigsetjmp(scope.env, 0)) {
+        pc = prog.pc_of(fault_index, memory.get_code_base());
+        exec_result result;
+        result.reason = EXIT_MEMORY_FAULT;
+        result.pc = pc;
+        result.addr = scope.fault_addr;
+        return result;
     }
+#endif
+    return run(prog);
 }
@@ -6,25 +6,97 @@
 #define CPU_RV32I_H
 
 #include <cstdint>
+#include <string>
 #include <vector>
 #include <stdexcept>
 
 #include "mem_rv32i.h"
 #include "dis_rv32i.h"
+#include "prog_rv32i.h"
+
+// Why guest execution stopped
+enum EXIT_REASON {
+    EXIT_RETURN,                // return to RETURN_SENTINEL, back to the host
+    EXIT_PC_UNDERFLOW,          // jump before the first instruction
+    EXIT_PC_MISALIGNED,         // jump to an odd pc or into a 4-byte instruction
+    EXIT_PC_OVERFLOW,           // jump or fall past the last instruction
+    EXIT_ILLEGAL_INSTRUCTION,   // reached a word that does not decode
+    EXIT_ECALL,                 // ECALL to a host call the program may not make
+    EXIT_EBREAK,
+    EXIT_MEMORY_FAULT           // access outside guest memory (reserved backend only)
+};
+
+// Outcome of one execute() call
+struct exec_result {
+    EXIT_REASON reason = EXIT_RETURN;
+    uint32_t pc = 0;    // the returning or faulting instruction (for a bad jump, the jump)
+    uint32_t addr = 0;  // bad jump target, faulting guest address, or refused host call number
+};
+
+// Human-readable description of a result, e.g. "PC alignment error"
+std::string describe(const exec_result& result);
+
+// Converts a guest pc into an index into the decoded program, validating it;
+// on failure sets the trap to raise and returns false. A pc inside a 4-byte
+// instruction counts as misaligned.
+inline bool checked_index(const prog_rv32i& prog, uint32_t pc, uint32_t code_base, size_t& index,
+                          EXIT_REASON& trap) {
+    if (pc < code_base) {
+        trap = EXIT_PC_UNDERFLOW;
+        return false;
+    }
+    uint32_t offset = pc - code_base;
+    if (offset % 2 != 0) {
+        trap = EXIT_PC_MISALIGNED;
+        return false;
+    }
+    if (offset / 2 >= prog.index_of.size()) {
+        trap = EXIT_PC_OVERFLOW;
+        return false;
+    }
+    index = prog.index_of[offset / 2];
+    if (index == prog_rv32i::NO_INSTRUCTION) {
+        trap = EXIT_PC_MISALIGNED;
+        return false;
+    }
+    return true;
+}
+
+// Zbb helpers; compilers turn the rotates into a single ror/rol
+inline uint32_t rotl32(uint32_t x, uint32_t n) {
+    return (x << (n & 31)) | (x >> ((32 - n) & 31));
+}
+inline uint32_t rotr32(uint32_t x, uint32_t n) {
+    return (x >> (n & 31)) | (x << ((32 - n) & 31));
+}
+// Every non-zero byte becomes 0xFF
+inline uint32_t orc_b(uint32_t x) {
+    uint32_t high = (((x & 0x7F7F7F7F) + 0x7F7F7F7F) | x) & 0x80808080;
+    return (high >> 7) * 0xFF;
+}
 
 // Main CPU core - executes RV32I instructions
 class cpu_rv32i {
 public:
+    // ra holds this when the guest starts; returning to it hands control back to the
+    // host, so the guest can make calls of its own. It is never a code address.
+    static constexpr uint32_t RETURN_SENTINEL = 0xFFFFFFF0;
+
     uint32_t registers[32];
 
     uint32_t pc;
 
     mem_rv32i memory;
 
-    cpu_rv32i();
+    explicit cpu_rv32i(const mem_layout& layout = mem_layout());
 
+    // Loads the code, points pc at its start and seeds ra with RETURN_SENTINEL
     void load_program(const std::vector<uint8_t>& program);
 
+    // Returns the CPU to its just-constructed state: registers cleared, sp at the
+    // top of the stack, and guest memory the previous call dirtied zeroed
+    void reset();
+
     uint32_t read_reg(uint8_t reg) const;
 
     void write_reg(uint8_t reg, uint32_t value);
@@ -37,7 +109,19 @@ public:
 
     void jump(uint32_t target);
 
-    void execute(const std::vector<std::unique_ptr<Instruction>>& instructions);
+    // Runs from pc until the guest returns or faults; guest faults never throw.
+    // pc is left at result.pc.
+    exec_result execute(const prog_rv32i& prog) noexcept;
+
+private:
+#ifdef RV32I_RESERVED_MEMORY
+    // Instruction whose memory access may fault, for reporting its pc after the
+    // fault handler jumps back to execute()
+    size_t fault_index = 0;
+#endif
+
+    // The interpreter loop proper; execute() wraps it with guest fault handling
+    exec_result run(const prog_rv32i& prog) noexcept;
 };
 
 uint32_t rv32i_call(const uint8_t* bytecode, size_t size,
@@ -1,6 +1,7 @@
 // dis_rv32i.cpp
 #include "dis_rv32i.h"
 #include "regs_rv32i.h"
+#include <array>
 #include <stdexcept>
 #include <sstream>
 
@@ -30,6 +31,17 @@ std::unique_ptr<Instruction> Instruction::create(uint32_t raw) {
     }
 }
 
+std::unique_ptr<Instruction> Instruction::createCompressed(uint16_t raw) {
+    uint32_t expanded = expandCompressed(raw);
+    if (expanded == 0) {
+        throw std::invalid_argument("Illegal compressed instruction");
+    }
+    std::unique_ptr<Instruction> inst = create(expanded);
+    inst->raw = raw;
+    inst->length = 2;
+    return inst;
+}
+
 // ------------------ IType ------------------
 IType::IType(uint32_t raw)
     : Instruction(raw)
@@ -52,11 +64,38 @@ IType::IType(uint32_t raw)
                     break;
                 case 0b111: mnemonic = ANDI;
                     break;
-                case 0b001: mnemonic = SLLI;
+                case 0b001: {
+                    // funct7 0110000 is a Zbb unary op, selected by the rs2 field
+                    uint8_t funct7 = static_cast<uint8_t>(raw >> 25);
+                    uint8_t sel = static_cast<uint8_t>((raw >> 20) & 0x1F);
+                    if (funct7 == 0b0000000) {
+                        mnemonic = SLLI;
+                    } else if (funct7 == 0b0110000 && sel <= 5 && sel != 3) {
+                        static constexpr MNEMONIC unary[] = {CLZ, CTZ, CPOP, INVALID, SEXT_B, SEXT_H};
+                        mnemonic = unary[sel];
+                    } else {
+                        throw std::invalid_argument("Unknown I-type funct7 for funct3=001");
+                    }
                     break;
-                case 0b101:
-                    mnemonic = ((raw >> 30) & 1) ? SRAI : SRLI;
+                }
+                case 0b101: {
+                    uint8_t funct7 = static_cast<uint8_t>(raw >> 25);
+                    uint8_t sel = static_cast<uint8_t>((raw >> 20) & 0x1F);
+                    if (funct7 == 0b0000000) {
+                        mnemonic = SRLI;
+                    } else if (funct7 == 0b0100000) {
+                        mnemonic = SRAI;
+                    } else if (funct7 == 0b0110000) {
+                        mnemonic = RORI;
+                    } else if (funct7 == 0b0010100 && sel == 0b00111) {
+                        mnemonic = ORC_B;
+                    } else if (funct7 == 0b0110100 && sel == 0b11000) {
+                        mnemonic = REV8;
+                    } else {
+                        throw std::invalid_argument("Unknown I-type funct7 for funct3=101");
+                    }
                     break;
+                }
                 default: throw std::invalid_argument("Unknown I-type funct3");
             }
             break;
@@ -98,6 +137,18 @@ std::string IType::toString() const {
         return os.str();
     }
 
+    // Zbb unary ops have no immediate operand
+    if (mnemonic == CLZ || mnemonic == CTZ || mnemonic == CPOP || mnemonic == SEXT_B ||
+        mnemonic == SEXT_H || mnemonic == ORC_B || mnemonic == REV8) {
+        os << " " << riscv_reg_to_abi(rd) << ", " << riscv_reg_to_abi(rs1);
+        return os.str();
+    }
+    if (mnemonic == RORI) {
+        os << " " << riscv_reg_to_abi(rd) << ", " << riscv_reg_to_abi(rs1)
+           << ", 0x" << std::hex << (imm & 0x1F) << std::dec;
+        return os.str();
+    }
+
     // Loads use offset(base) syntax: LB, LH, LW, LBU, LHU
     if (mnemonic == LB || mnemonic == LH || mnemonic == LW ||
         mnemonic == LBU || mnemonic == LHU) {
@@ -112,6 +163,10 @@ std::string IType::toString() const {
     return os.str();
 }
 
+DecodedInst IType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), rd, rs1, 0, imm};
+}
+
 // ------------------ UType ------------------
 UType::UType(uint32_t raw)
     : Instruction(raw)
@@ -136,6 +191,10 @@ std::string UType::toString() const {
     return os.str();
 }
 
+DecodedInst UType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), rd, 0, 0, static_cast<int32_t>(imm)};
+}
+
 // ------------------ SType ------------------
 
 SType::SType(uint32_t raw)
@@ -176,6 +235,10 @@ std::string SType::toString() const {
     return os.str();
 }
 
+DecodedInst SType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), 0, rs1, rs2, imm};
+}
+
 // ------------------ RType ------------------
 RType::RType(uint32_t raw)
     : Instruction(raw) {
@@ -186,14 +249,41 @@ RType::RType(uint32_t raw)
     funct3 = static_cast<uint8_t>((raw >> 12) & 0x07); // bits [14:12]
     rd = static_cast<uint8_t>((raw >> 7) & 0x1F); // bits [11:7]
 
-    // Determine the mnemonic based on funct3 and funct7
+    // Other funct7 groups (RV32M, Zba, Zbb): funct3 selects the operation
+    static constexpr MNEMONIC muldiv[] = {MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU};
+    static constexpr MNEMONIC shadd[] = {INVALID, INVALID, SH1ADD, INVALID, SH2ADD, INVALID, SH3ADD, INVALID};
+    static constexpr MNEMONIC minmax[] = {INVALID, INVALID, INVALID, INVALID, MIN, MINU, MAX, MAXU};
+    static constexpr MNEMONIC rotate[] = {INVALID, ROL, INVALID, INVALID, INVALID, ROR, INVALID, INVALID};
+    static constexpr MNEMONIC inverted[] = {SUB, INVALID, INVALID, INVALID, XNOR, SRA, ORN, ANDN};
+    switch (funct7) {
+        case 0b0000000: break;
+        case 0b0000001: mnemonic = muldiv[funct3];
+            return;
+        case 0b0100000: mnemonic = inverted[funct3];
+            break;
+        case 0b0010000: mnemonic = shadd[funct3];
+            break;
+        case 0b0000101: mnemonic = minmax[funct3];
+            break;
+        case 0b0110000: mnemonic = rotate[funct3];
+            break;
+        case 0b0000100:
+            // ZEXT.H is the RV32 encoding of PACK rd, rs1, x0
+            mnemonic = (funct3 == 0b100 && rs2 == 0) ? ZEXT_H : INVALID;
+            break;
+        default:
+            throw std::invalid_argument("Unknown R-type funct7");
+    }
+    if (funct7 != 0) {
+        if (mnemonic == INVALID) {
+            throw std::invalid_argument("Unknown R-type funct7");
+        }
+        return;
+    }
+
+    // Determine the mnemonic based on funct3
     switch (funct3) {
-        case 0b000:
-            mnemonic = (funct7 == 0b0000000)
-                           ? ADD
-                           : (funct7 == 0b0100000)
-                                 ? SUB
-                                 : throw std::invalid_argument("Unknown R-type funct7 for funct3=000");
+        case 0b000: mnemonic = ADD;
             break;
         case 0b001: mnemonic = SLL;
             break;
@@ -203,12 +293,7 @@ RType::RType(uint32_t raw)
             break;
         case 0b100: mnemonic = XOR;
             break;
-        case 0b101:
-            mnemonic = (funct7 == 0b0000000)
-                           ? SRL
-                           : (funct7 == 0b0100000)
-                                 ? SRA
-                                 : throw std::invalid_argument("Unknown R-type funct7 for funct3=101");
+        case 0b101: mnemonic = SRL;
             break;
         case 0b110: mnemonic = OR;
             break;
@@ -223,11 +308,17 @@ std::string RType::toString() const {
     std::ostringstream os;
     os << mnemonicToString(mnemonic)
             << " " << riscv_reg_to_abi(rd)
-            << ", " << riscv_reg_to_abi(rs1)
-            << ", " << riscv_reg_to_abi(rs2);
+            << ", " << riscv_reg_to_abi(rs1);
+    if (mnemonic != ZEXT_H) {
+        os << ", " << riscv_reg_to_abi(rs2);
+    }
     return os.str();
 }
 
+DecodedInst RType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), rd, rs1, rs2, 0};
+}
+
 // ------------------ BType ------------------
 
 
@@ -248,7 +339,7 @@ BType::BType(uint32_t raw)
 
     // sign-extend from bit 12
     if (imm13 & 0b1000000000000)
-        imm = static_cast<int32_t>(imm13 | 0b11111111111111110000000000000000);
+        imm = static_cast<int32_t>(imm13 | 0b11111111111111111110000000000000);
     else
         imm = static_cast<int32_t>(imm13);
 
@@ -284,6 +375,10 @@ std::string BType::toString() const {
     return os.str();;
 }
 
+DecodedInst BType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), 0, rs1, rs2, imm};
+}
+
 // ------------------ JType ------------------
 
 JType::JType(uint32_t raw)
@@ -321,6 +416,10 @@ std::string JType::toString() const {
     return os.str();
 }
 
+DecodedInst JType::toDecoded() const {
+    return {static_cast<uint8_t>(mnemonic), rd, 0, 0, imm};
+}
+
 // ------------------ FenceType ------------------
 // FenceType constructor
 FenceType::FenceType(uint32_t raw)
@@ -388,4 +487,447 @@ std::unique_ptr<Instruction> decodeInstruction(uint32_t rawInst) {
     return Instruction::create(rawInst);
 }
 
+// ------------------ RV32C expansion ------------------
+
+namespace {
+
+// 32-bit encodings of the formats compressed instructions expand to
+constexpr uint32_t enc_i(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm) {
+    return (static_cast<uint32_t>(imm) & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+constexpr uint32_t enc_s(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (u >> 5 & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (u & 0x1F) << 7 | 0b0100011;
+}
+constexpr uint32_t enc_r(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | 0b0110011;
+}
+constexpr uint32_t enc_b(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (u >> 12 & 1) << 31 | (u >> 5 & 0x3F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12
+           | (u >> 1 & 0xF) << 8 | (u >> 11 & 1) << 7 | 0b1100011;
+}
+constexpr uint32_t enc_j(uint32_t rd, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (u >> 20 & 1) << 31 | (u >> 1 & 0x3FF) << 21 | (u >> 11 & 1) << 20 | (u >> 12 & 0xFF) << 12
+           | rd << 7 | 0b1101111;
+}
+
+// Bit n of x, placed at position to
+constexpr uint32_t bit(uint32_t x, uint32_t n, uint32_t to) { return (x >> n & 1) << to; }
+
+// Sign-extends the low bits of x
+constexpr int32_t sext(uint32_t x, uint32_t bits) {
+    return static_cast<int32_t>(x << (32 - bits)) >> (32 - bits);
+}
+
+// C.J / C.JAL offset[11|4|9:8|10|6|7|3:1|5]
+constexpr int32_t cj_offset(uint32_t c) {
+    return sext(bit(c, 12, 11) | bit(c, 11, 4) | bit(c, 10, 9) | bit(c, 9, 8) | bit(c, 8, 10)
+                | bit(c, 7, 6) | bit(c, 6, 7) | bit(c, 5, 3) | bit(c, 4, 2) | bit(c, 3, 1) | bit(c, 2, 5), 12);
+}
+
+// C.BEQZ / C.BNEZ offset[8|4:3|7:6|2:1|5]
+constexpr int32_t cb_offset(uint32_t c) {
+    return sext(bit(c, 12, 8) | bit(c, 11, 4) | bit(c, 10, 3) | bit(c, 6, 7) | bit(c, 5, 6)
+                | bit(c, 4, 2) | bit(c, 3, 1) | bit(c, 2, 5), 9);
+}
 
+}
+
+uint32_t expandCompressed(uint16_t raw) noexcept {
+    uint32_t c = raw;
+    uint32_t funct3 = c >> 13;
+    uint32_t rd = c >> 7 & 0x1F;            // rd/rs1 in the full register forms
+    uint32_t rs2 = c >> 2 & 0x1F;
+    uint32_t rdp = 8 + (c >> 2 & 0x7);      // rd'/rs2' (x8-x15) in bits 4:2
+    uint32_t rs1p = 8 + (c >> 7 & 0x7);     // rs1'/rd' in bits 9:7
+    int32_t imm6 = sext(bit(c, 12, 5) | (c >> 2 & 0x1F), 6);   // imm[5|4:0] of CI formats
+
+    switch (c & 0b11) {
+        case 0b00:
+            switch (funct3) {
+                case 0b000: {   // C.ADDI4SPN
+                    uint32_t nzuimm = (c >> 7 & 0xF) << 6 | (c >> 11 & 0x3) << 4 | bit(c, 5, 3) | bit(c, 6, 2);
+                    return nzuimm ? enc_i(0b0010011, 0, rdp, 2, static_cast<int32_t>(nzuimm)) : 0;
+                }
+                case 0b010:     // C.LW
+                case 0b110: {   // C.SW
+                    int32_t uimm = static_cast<int32_t>((c >> 10 & 0x7) << 3 | bit(c, 6, 2) | bit(c, 5, 6));
+                    return funct3 == 0b010 ? enc_i(0b0000011, 0b010, rdp, rs1p, uimm) : enc_s(0b010, rs1p, rdp, uimm);
+                }
+                default:        // floating point and reserved
+                    return 0;
+            }
+
+        case 0b01:
+            switch (funct3) {
+                case 0b000:     // C.ADDI (C.NOP for rd = x0)
+                    return enc_i(0b0010011, 0, rd, rd, imm6);
+                case 0b001:     // C.JAL
+                    return enc_j(1, cj_offset(c));
+                case 0b010:     // C.LI
+                    return enc_i(0b0010011, 0, rd, 0, imm6);
+                case 0b011:
+                    if (rd == 2) {  // C.ADDI16SP
+                        int32_t nzimm = sext(bit(c, 12, 9) | bit(c, 6, 4) | bit(c, 5, 6) | bit(c, 4, 8)
+                                             | bit(c, 3, 7) | bit(c, 2, 5), 10);
+                        return nzimm ? enc_i(0b0010011, 0, 2, 2, nzimm) : 0;
+                    }
+                    // C.LUI
+                    return imm6 ? static_cast<uint32_t>(imm6) << 12 | rd << 7 | 0b0110111 : 0;
+                case 0b100:
+                    switch (c >> 10 & 0x3) {
+                        case 0b00:  // C.SRLI, shamt[5] must be 0 on RV32
+                        case 0b01:  // C.SRAI
+                            if (bit(c, 12, 0)) {
+                                return 0;
+                            }
+                            return enc_i(0b0010011, 0b101, rs1p, rs1p,
+                                         static_cast<int32_t>(rs2 | (c >> 10 & 1) << 10));
+                        case 0b10:  // C.ANDI
+                            return enc_i(0b0010011, 0b111, rs1p, rs1p, imm6);
+                        default: {
+                            if (bit(c, 12, 0)) {
+                                return 0;   // RV64 C.SUBW/C.ADDW
+                            }
+                            // C.SUB, C.XOR, C.OR, C.AND
+                            static constexpr uint32_t funct3s[] = {0b000, 0b100, 0b110, 0b111};
+                            uint32_t sel = c >> 5 & 0x3;
+                            return enc_r(sel == 0 ? 0b0100000 : 0, funct3s[sel], rs1p, rs1p, rdp);
+                        }
+                    }
+                case 0b101:     // C.J
+                    return enc_j(0, cj_offset(c));
+                case 0b110:     // C.BEQZ
+                    return enc_b(0b000, rs1p, 0, cb_offset(c));
+                default:        // C.BNEZ
+                    return enc_b(0b001, rs1p, 0, cb_offset(c));
+            }
+
+        case 0b10:
+            switch (funct3) {
+                case 0b000:     // C.SLLI, shamt[5] must be 0 on RV32
+                    return bit(c, 12, 0) ? 0 : enc_i(0b0010011, 0b001, rd, rd, static_cast<int32_t>(rs2));
+                case 0b010: {   // C.LWSP
+                    int32_t uimm = static_cast<int32_t>(bit(c, 12, 5) | (c >> 4 & 0x7) << 2 | (c >> 2 & 0x3) << 6);
+                    return rd ? enc_i(0b0000011, 0b010, rd, 2, uimm) : 0;
+                }
+                case 0b100:
+                    if (!bit(c, 12, 0)) {
+                        if (rs2 == 0) {     // C.JR
+                            return rd ? enc_i(0b1100111, 0, 0, rd, 0) : 0;
+                        }
+                        return enc_r(0, 0, rd, 0, rs2);     // C.MV
+                    }
+                    if (rs2 == 0) {
+                        // C.EBREAK, C.JALR
+                        return rd ? enc_i(0b1100111, 0, 1, rd, 0) : 0x00100073;
+                    }
+                    return enc_r(0, 0, rd, rd, rs2);        // C.ADD
+                case 0b110: {   // C.SWSP
+                    int32_t uimm = static_cast<int32_t>((c >> 9 & 0xF) << 2 | (c >> 7 & 0x3) << 6);
+                    return enc_s(0b010, 2, rs2, uimm);
+                }
+                default:        // floating point
+                    return 0;
+            }
+
+        default:
+            return 0;   // a 32-bit instruction
+    }
+}
+
+// ------------------ Table-driven decoder ------------------
+
+namespace {
+
+// Extra check an entry needs beyond opcode/funct3
+enum DECODE_RULE : uint8_t {
+    RULE_NONE,
+    RULE_FUNCT7,    // funct7 0000000 selects op, 0100000 selects alt (if any), the other
+                    // groups in op_groups pick by funct3, anything else is invalid
+    RULE_SHIFT_LEFT,    // SLLI, or a Zbb unary op selected by rs2
+    RULE_SHIFT_RIGHT,   // SRLI, alt (SRAI) for funct7 0100000, or RORI/ORC.B/REV8
+    RULE_RET,       // JALR x0, 0(ra) is RET
+    RULE_FENCE,     // FENCE / FENCE.TSO / PAUSE from fm, pred, succ
+    RULE_SYSTEM     // ECALL / EBREAK, all other fields zero
+};
+
+struct decode_entry {
+    uint8_t format;     // INS_TYPE
+    uint8_t op;         // MNEMONIC, INVALID if the slot decodes nothing
+    uint8_t alt;        // second MNEMONIC picked by the rule
+    uint8_t rule;       // DECODE_RULE
+    uint8_t status;     // DECODE_STATUS when op is INVALID
+};
+
+// Indexed by opcode[6:2] and funct3; opcode[1:0] must be 11
+constexpr size_t table_index(uint32_t opcode, uint32_t funct3) {
+    return ((opcode >> 2) & 0x1F) << 3 | (funct3 & 0x7);
+}
+
+constexpr std::array<decode_entry, 256> build_decode_table() {
+    std::array<decode_entry, 256> t{};
+    for (decode_entry& e : t) {
+        e = {I_TYPE, INVALID, INVALID, RULE_NONE, DECODE_UNKNOWN_OPCODE};
+    }
+
+    // Known opcodes default to "bad funct3" until a funct3 is filled in
+    auto opcode = [&t](uint32_t op) {
+        for (uint32_t f3 = 0; f3 < 8; f3++) {
+            t[table_index(op, f3)].status = DECODE_UNKNOWN_FUNCT;
+        }
+    };
+    auto set = [&t](uint32_t op, uint32_t f3, INS_TYPE format, MNEMONIC m,
+                    MNEMONIC alt = INVALID, DECODE_RULE rule = RULE_NONE) {
+        t[table_index(op, f3)] = {static_cast<uint8_t>(format), static_cast<uint8_t>(m),
+                                  static_cast<uint8_t>(alt), static_cast<uint8_t>(rule), DECODE_OK};
+    };
+
+    opcode(0b0110111);
+    opcode(0b0010111);
+    opcode(0b1101111);
+    for (uint32_t f3 = 0; f3 < 8; f3++) {
+        // funct3 is part of the immediate (or ignored) for these
+        set(0b0110111, f3, U_TYPE, LUI);
+        set(0b0010111, f3, U_TYPE, AUIPC);
+        set(0b1101111, f3, J_TYPE, JAL);
+    }
+
+    opcode(0b1100111);
+    for (uint32_t f3 = 0; f3 < 8; f3++) {
+        set(0b1100111, f3, I_TYPE, JALR, RET, RULE_RET);
+    }
+
+    opcode(0b0000011);
+    set(0b0000011, 0, I_TYPE, LB);
+    set(0b0000011, 1, I_TYPE, LH);
+    set(0b0000011, 2, I_TYPE, LW);
+    set(0b0000011, 4, I_TYPE, LBU);
+    set(0b0000011, 5, I_TYPE, LHU);
+
+    opcode(0b0010011);
+    set(0b0010011, 0, I_TYPE, ADDI);
+    set(0b0010011, 1, I_TYPE, SLLI, INVALID, RULE_SHIFT_LEFT);
+    set(0b0010011, 2, I_TYPE, SLTI);
+    set(0b0010011, 3, I_TYPE, SLTIU);
+    set(0b0010011, 4, I_TYPE, XORI);
+    set(0b0010011, 5, I_TYPE, SRLI, SRAI, RULE_SHIFT_RIGHT);
+    set(0b0010011, 6, I_TYPE, ORI);
+    set(0b0010011, 7, I_TYPE, ANDI);
+
+    opcode(0b0100011);
+    set(0b0100011, 0, S_TYPE, SB);
+    set(0b0100011, 1, S_TYPE, SH);
+    set(0b0100011, 2, S_TYPE, SW);
+
+    opcode(0b0110011);
+    set(0b0110011, 0, R_TYPE, ADD, SUB, RULE_FUNCT7);
+    set(0b0110011, 1, R_TYPE, SLL, INVALID, RULE_FUNCT7);
+    set(0b0110011, 2, R_TYPE, SLT, INVALID, RULE_FUNCT7);
+    set(0b0110011, 3, R_TYPE, SLTU, INVALID, RULE_FUNCT7);
+    set(0b0110011, 4, R_TYPE, XOR, XNOR, RULE_FUNCT7);
+    set(0b0110011, 5, R_TYPE, SRL, SRA, RULE_FUNCT7);
+    set(0b0110011, 6, R_TYPE, OR, ORN, RULE_FUNCT7);
+    set(0b0110011, 7, R_TYPE, AND, ANDN, RULE_FUNCT7);
+
+    opcode(0b1100011);
+    set(0b1100011, 0, B_TYPE, BEQ);
+    set(0b1100011, 1, B_TYPE, BNE);
+    set(0b1100011, 4, B_TYPE, BLT);
+    set(0b1100011, 5, B_TYPE, BGE);
+    set(0b1100011, 6, B_TYPE, BLTU);
+    set(0b1100011, 7, B_TYPE, BGEU);
+
+    opcode(0b0001111);
+    set(0b0001111, 0, FENCE_TYPE, FENCE, INVALID, RULE_FENCE);
+
+    opcode(0b1110011);
+    set(0b1110011, 0, SYS_TYPE, ECALL, EBREAK, RULE_SYSTEM);
+    return t;
+}
+
+constexpr std::array<decode_entry, 256> decode_table = build_decode_table();
+
+// OP funct7 groups besides 0000000/0100000, operations by funct3 (INVALID: none)
+struct funct7_group {
+    uint8_t funct7;
+    uint8_t ops[8];
+};
+constexpr funct7_group op_groups[] = {
+    {0b0000001, {MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU}},                    // RV32M
+    {0b0010000, {INVALID, INVALID, SH1ADD, INVALID, SH2ADD, INVALID, SH3ADD, INVALID}}, // Zba
+    {0b0000101, {INVALID, INVALID, INVALID, INVALID, MIN, MINU, MAX, MAXU}},           // Zbb
+    {0b0110000, {INVALID, ROL, INVALID, INVALID, INVALID, ROR, INVALID, INVALID}},
+    {0b0000100, {INVALID, INVALID, INVALID, INVALID, ZEXT_H, INVALID, INVALID, INVALID}},
+};
+
+// Zbb unary ops under SLLI's funct3 with funct7 0110000, by rs2
+constexpr uint8_t unary_ops[6] = {CLZ, CTZ, CPOP, INVALID, SEXT_B, SEXT_H};
+
+}
+
+DECODE_STATUS decodeMnemonic(uint32_t raw, uint8_t& op, uint8_t& format) noexcept {
+    op = INVALID;
+    format = SYS_TYPE;
+    if ((raw & 0b11) != 0b11) {
+        return DECODE_UNKNOWN_OPCODE;
+    }
+    const decode_entry& e = decode_table[table_index(raw, raw >> 12)];
+    if (e.op == INVALID) {
+        return static_cast<DECODE_STATUS>(e.status);
+    }
+
+    uint8_t m = e.op;
+    switch (e.rule) {
+        case RULE_FUNCT7: {
+            uint32_t funct7 = raw >> 25;
+            if (funct7 == 0) {
+                break;
+            }
+            if (funct7 == 0b0100000) {
+                m = e.alt;
+            } else {
+                m = INVALID;
+                for (const funct7_group& g : op_groups) {
+                    if (g.funct7 == funct7) {
+                        m = g.ops[(raw >> 12) & 0x7];
+                        break;
+                    }
+                }
+                // ZEXT.H is PACK with rs2 = x0
+                if (m == ZEXT_H && ((raw >> 20) & 0x1F) != 0) {
+                    m = INVALID;
+                }
+            }
+            if (m == INVALID) {
+                return DECODE_UNKNOWN_FUNCT;
+            }
+            break;
+        }
+        case RULE_SHIFT_LEFT: {
+            uint32_t funct7 = raw >> 25;
+            uint32_t sel = (raw >> 20) & 0x1F;
+            if (funct7 == 0b0110000 && sel < 6) {
+                m = unary_ops[sel];
+            } else if (funct7 != 0) {
+                m = INVALID;
+            }
+            if (m == INVALID) {
+                return DECODE_UNKNOWN_FUNCT;
+            }
+            break;
+        }
+        case RULE_SHIFT_RIGHT: {
+            uint32_t funct7 = raw >> 25;
+            uint32_t sel = (raw >> 20) & 0x1F;
+            if (funct7 == 0b0100000) {
+                m = e.alt;
+            } else if (funct7 == 0b0110000) {
+                m = RORI;
+            } else if (funct7 == 0b0010100 && sel == 0b00111) {
+                m = ORC_B;
+            } else if (funct7 == 0b0110100 && sel == 0b11000) {
+                m = REV8;
+            } else if (funct7 != 0) {
+                return DECODE_UNKNOWN_FUNCT;
+            }
+            break;
+        }
+        case RULE_RET:
+            // rd == 0, rs1 == ra, imm == 0
+            if ((raw & 0xFFFFFF80) == (1u << 15)) {
+                m = e.alt;
+            }
+            break;
+        case RULE_FENCE: {
+            uint32_t fm = raw >> 28;
+            uint32_t pred = (raw >> 24) & 0xF;
+            uint32_t succ = (raw >> 20) & 0xF;
+            if (fm == 0b1000 && pred == 0b0011 && succ == 0b0011) {
+                m = FENCE_TSO;
+            } else if (fm == 0 && pred == 0b0001 && succ == 0) {
+                m = PAUSE;
+            } else if (fm != 0) {
+                return DECODE_BAD_OPERANDS;
+            }
+            break;
+        }
+        case RULE_SYSTEM:
+            // rd and rs1 must be zero (funct3 already is)
+            if (raw & 0x000F8F80) {
+                return DECODE_BAD_OPERANDS;
+            }
+            if ((raw >> 20) == 1) {
+                m = e.alt;
+            } else if ((raw >> 20) != 0) {
+                return DECODE_UNKNOWN_FUNCT;
+            }
+            break;
+        default:
+            break;
+    }
+
+    op = m;
+    format = e.format;
+    return DECODE_OK;
+}
+
+DECODE_STATUS decodeInstruction(uint32_t raw, DecodedInst& out) noexcept {
+    uint8_t op;
+    uint8_t format;
+    DECODE_STATUS status = decodeMnemonic(raw, op, format);
+    if (status != DECODE_OK) {
+        out = {INVALID, 0, 0, 0, 0};
+        return status;
+    }
+
+    uint8_t rd = (raw >> 7) & 0x1F;
+    uint8_t rs1 = (raw >> 15) & 0x1F;
+    uint8_t rs2 = (raw >> 20) & 0x1F;
+
+    // Same field layout as the Instruction subclasses' toDecoded()
+    switch (format) {
+        case I_TYPE:
+            out = {op, rd, rs1, 0, static_cast<int32_t>(raw) >> 20};
+            break;
+        case U_TYPE:
+            out = {op, rd, 0, 0, static_cast<int32_t>(raw & 0xFFFFF000)};
+            break;
+        case S_TYPE:
+            out = {op, 0, rs1, rs2, (static_cast<int32_t>(raw) >> 25) * 32 | static_cast<int32_t>((raw >> 7) & 0x1F)};
+            break;
+        case R_TYPE:
+            out = {op, rd, rs1, rs2, 0};
+            break;
+        case B_TYPE:
+            out = {op, 0, rs1, rs2,
+                   (static_cast<int32_t>(raw) >> 31) * 4096     // imm[12], sign-extended
+                   | static_cast<int32_t>(((raw >> 7) & 0x1) << 11
+                                          | ((raw >> 25) & 0x3F) << 5
+                                          | ((raw >> 8) & 0xF) << 1)};
+            break;
+        case J_TYPE:
+            out = {op, rd, 0, 0,
+                   (static_cast<int32_t>(raw) >> 31) * (1 << 20)  // imm[20], sign-extended
+                   | static_cast<int32_t>(((raw >> 12) & 0xFF) << 12
+                                          | ((raw >> 20) & 0x1) << 11
+                                          | ((raw >> 21) & 0x3FF) << 1)};
+            break;
+        default:    // FENCE_TYPE, SYS_TYPE: no operands
+            out = {op, 0, 0, 0, 0};
+            break;
+    }
+    return DECODE_OK;
+}
+
+const char* decodeStatusToString(DECODE_STATUS status) {
+    switch (status) {
+        case DECODE_OK: return "OK";
+        case DECODE_UNKNOWN_OPCODE: return "Unknown opcode";
+        case DECODE_UNKNOWN_FUNCT: return "Unknown funct3/funct7";
+        case DECODE_BAD_OPERANDS: return "Invalid operand fields";
+    }
+    return "Unknown decode status";
+}
@@ -15,11 +15,17 @@ enum MNEMONIC {
     SB, SH, SW,
     SLLI, SRLI, SRAI,
     ADD, SUB, SLL, SLT, SLTU, XOR, SRL, SRA, OR, AND,
+    MUL, MULH, MULHSU, MULHU, DIV, DIVU, REM, REMU,     // RV32M
+    SH1ADD, SH2ADD, SH3ADD,                             // Zba
+    ANDN, ORN, XNOR, MIN, MINU, MAX, MAXU, ROL, ROR, ZEXT_H,  // Zbb, register operands
+    CLZ, CTZ, CPOP, SEXT_B, SEXT_H, RORI, ORC_B, REV8,  // Zbb, OP-IMM encodings
     BEQ, BNE, BLT, BGE, BLTU, BGEU,
     JAL,
     RET,
     FENCE, FENCE_TSO, PAUSE,
-    ECALL, EBREAK
+    ECALL, EBREAK,
+    INVALID,        // not a real instruction: stop word after the last decoded instruction
+    MNEMONIC_COUNT
 };
 
 
@@ -31,19 +37,66 @@ inline const char *mnemonicToString(MNEMONIC m) {
         "SB", "SH", "SW",
         "SLLI", "SRLI", "SRAI",
         "ADD", "SUB", "SLL", "SLT", "SLTU", "XOR", "SRL", "SRA", "OR", "AND",
+        "MUL", "MULH", "MULHSU", "MULHU", "DIV", "DIVU", "REM", "REMU",
+        "SH1ADD", "SH2ADD", "SH3ADD",
+        "ANDN", "ORN", "XNOR", "MIN", "MINU", "MAX", "MAXU", "ROL", "ROR", "ZEXT_H",
+        "CLZ", "CTZ", "CPOP", "SEXT_B", "SEXT_H", "RORI", "ORC_B", "REV8",
         "BEQ", "BNE", "BLT", "BGE", "BLTU", "BGEU",
         "JAL",
         "RET",
         "FENCE", "FENCE_TSO", "PAUSE",
-        "ECALL", "EBREAK"
+        "ECALL", "EBREAK",
+        "INVALID"
     };
     return names[static_cast<size_t>(m)];
 }
 
+// Compact decoded form the interpreter runs on, stored contiguously per program.
+// Unused fields are zero; imm holds the sign-extended immediate (U-type: imm[31:12] << 12).
+struct DecodedInst {
+    uint8_t op;     // MNEMONIC
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;
+};
+static_assert(sizeof(DecodedInst) == 8, "DecodedInst should stay 8 bytes");
+
+// Outcome of the allocation-free decoder
+enum DECODE_STATUS {
+    DECODE_OK,
+    DECODE_UNKNOWN_OPCODE,      // low 7 bits are not an RV32I opcode
+    DECODE_UNKNOWN_FUNCT,       // opcode is known but funct3/funct7 select nothing
+    DECODE_BAD_OPERANDS         // FENCE/SYSTEM encoding with fields that must be fixed
+};
+
+// Decodes one word straight into out using a lookup table keyed on opcode/funct3
+// (with funct7 resolved per entry). Never allocates or throws; on failure out is
+// set to the INVALID stop word. Accepts exactly what Instruction::create accepts.
+DECODE_STATUS decodeInstruction(uint32_t raw, DecodedInst& out) noexcept;
+
+// The mnemonic-selection half of decodeInstruction: picks op (MNEMONIC) and format
+// (INS_TYPE) from opcode/funct3/funct7 without extracting operands. On failure op
+// is INVALID. Used by the batch decoder once the fields are extracted in bulk.
+DECODE_STATUS decodeMnemonic(uint32_t raw, uint8_t& op, uint8_t& format) noexcept;
+
+const char* decodeStatusToString(DECODE_STATUS status);
+
+// RV32C: an instruction whose low two bits are not 11 is 16 bits long
+inline bool isCompressed(uint16_t low) { return (low & 0b11) != 0b11; }
+
+// Expands a 16-bit RV32C instruction to the 32-bit instruction it stands for, which
+// the decoders then handle as usual. Returns 0 (never a valid instruction) for
+// reserved encodings and the F/D loads and stores.
+uint32_t expandCompressed(uint16_t raw) noexcept;
+
 class Instruction {
 public:
     // Factory: returns the correct subclass based on the low‑7 bits
     static std::unique_ptr<Instruction> create(uint32_t raw);
+    // Same for a 16-bit RV32C instruction, decoded as its 32-bit expansion;
+    // getRaw() still returns the 16-bit encoding
+    static std::unique_ptr<Instruction> createCompressed(uint16_t raw);
 
     virtual ~Instruction() = default;
 
@@ -54,6 +107,7 @@ public:
     uint32_t getRaw() const { return raw; }
     uint8_t getOpcode() const { return opcode; }
     MNEMONIC getMnemonic() const { return mnemonic; }
+    uint32_t getLength() const { return length; }   // in bytes, 2 for RV32C
 
     // Methods for control flow analysis
     virtual bool isBranch() const { return false; }
@@ -61,6 +115,9 @@ public:
     virtual bool isConditional() const { return false; }
     virtual int32_t getImmediate() const { return 0; }  // For branch/jump targets
 
+    // Flattened operands for the interpreter
+    virtual DecodedInst toDecoded() const { return {static_cast<uint8_t>(mnemonic), 0, 0, 0, 0}; }
+
 protected:
     explicit Instruction(uint32_t raw)
         : raw(raw), opcode(static_cast<uint8_t>(raw & 0x7F)) {
@@ -69,6 +126,7 @@ protected:
     uint32_t raw; //< the full 32‑bit instruction
     uint8_t opcode; //< bits[6:0]
     MNEMONIC mnemonic; // enum goes here
+    uint32_t length = 4; //< 2 if expanded from a compressed instruction
 };
 
 // I‑type: imm[31:20] | rs1[19:15] | funct3[14:12] | rd[11:7] | opcode[6:0]
@@ -77,6 +135,7 @@ public:
     explicit IType(uint32_t raw);
 
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     bool isJump() const override { return mnemonic == JALR; }
     int32_t getImmediate() const override { return imm; }
@@ -93,6 +152,7 @@ public:
     explicit UType(uint32_t raw);
 
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     uint32_t imm; // 31:12
     uint8_t rd; // 11:7
@@ -106,6 +166,7 @@ public:
     explicit SType(uint32_t raw);
 
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     int32_t imm; // 31:25 and 11:7
     uint8_t rs1, rs2, funct3;
@@ -119,6 +180,7 @@ public:
     explicit RType(uint32_t raw);
 
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     uint8_t funct7; // Function code (bits 31–25)
     uint8_t rs2; // Source register 2 (bits 24–20)
@@ -135,6 +197,7 @@ public:
     explicit BType(uint32_t raw);
 
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     bool isBranch() const override { return true; }
     bool isConditional() const override { return true; }
@@ -152,6 +215,7 @@ class JType : public Instruction {
 public:
     //JType(uint32_t raw) : Instruction(raw) {};
     std::string toString() const override;
+    DecodedInst toDecoded() const override;
 
     explicit JType(uint32_t raw);
 
@@ -1,97 +1,705 @@
 #include "emulator_api.h"
 #include "cpu_rv32i.h"
-#include "dis_rv32i.h"
-#include "../obf/restore.h"
+#include "host_rv32i.h"
+#include "lanes_rv32i.h"
+#include "pool_rv32i.h"
+#include "prog_rv32i.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
-#include <vector>
-#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
 
-extern "C" {
+struct rv32i_program {
+    prog_rv32i prog;
+    bool lockstep = false;  // batch calls run in lanes_rv32i groups
+};
 
-uint32_t rv32i_call(const uint8_t* bytecode, size_t size, ...) {
-    cpu_rv32i cpu;
-
-    // load
-    std::vector<uint8_t> code(bytecode, bytecode + size);
-    deobfuscate(code);
-    cpu.load_program(code);
-
-    // Decode instructions from the restored code
-    std::vector<std::unique_ptr<Instruction>> instructions;
-    for (size_t i = 0; i < code.size(); i += 4) {
-        uint32_t raw = 0;
-        if (i + 4 <= code.size()) {
-            // Read from restored code (little-endian)
-            raw = code[i] | (code[i+1] << 8) | (code[i+2] << 16) | (code[i+3] << 24);
-        } else {
-             // Should not happen if aligned
-            memcpy(&raw, code.data() + i, code.size() - i);
+struct rv32i_pool {
+    rv32i_pool(unsigned workers, const std::vector<int>& cpus) : pool(workers, cpus) {}
+    pool_rv32i pool;
+};
+
+struct rv32i_future {
+    std::shared_ptr<pool_call> call;
+};
+
+// Per-thread pool of CPU contexts. A call leases one and hands it back reset, so
+// repeated calls reuse the register file and already-allocated guest memory instead
+// of building a fresh cpu_rv32i; more than one can be out at a time if a call
+// re-enters the API.
+class cpu_pool {
+    static constexpr size_t MAX_IDLE = 4;
+    std::vector<std::unique_ptr<cpu_rv32i>> idle;
+
+public:
+    cpu_pool() { idle.reserve(MAX_IDLE); }
+
+    std::unique_ptr<cpu_rv32i> acquire() {
+        if (idle.empty()) {
+            return std::make_unique<cpu_rv32i>();
         }
-        instructions.push_back(decodeInstruction(raw));
+        std::unique_ptr<cpu_rv32i> cpu = std::move(idle.back());
+        idle.pop_back();
+        return cpu;
     }
 
-    // Set arguments
-    va_list args;
-    va_start(args, size);
+    // Never throws, since leases release from their destructor; a CPU that can't be
+    // reset is dropped instead of pooled
+    void release(std::unique_ptr<cpu_rv32i> cpu) noexcept {
+        if (idle.size() < MAX_IDLE) {
+            try {
+                cpu->reset();
+            } catch (const std::exception&) {
+                return;
+            }
+            idle.push_back(std::move(cpu));
+        }
+    }
+};
+
+static thread_local cpu_pool pool;
+
+// A pooled CPU for the duration of one call. Building one can throw when guest
+// memory can't be set up, so callers lease inside a try.
+class cpu_lease {
+    std::unique_ptr<cpu_rv32i> cpu;
+
+public:
+    cpu_lease() : cpu(pool.acquire()) {}
+    ~cpu_lease() { pool.release(std::move(cpu)); }
+
+    cpu_rv32i& operator*() { return *cpu; }
+    cpu_rv32i* operator->() { return cpu.get(); }
+};
+
+static_assert(RV32I_EXIT_RETURN == (int)EXIT_RETURN && RV32I_EXIT_PC_UNDERFLOW == (int)EXIT_PC_UNDERFLOW &&
+              RV32I_EXIT_PC_MISALIGNED == (int)EXIT_PC_MISALIGNED && RV32I_EXIT_PC_OVERFLOW == (int)EXIT_PC_OVERFLOW &&
+              RV32I_EXIT_ILLEGAL_INSTRUCTION == (int)EXIT_ILLEGAL_INSTRUCTION && RV32I_EXIT_ECALL == (int)EXIT_ECALL &&
+              RV32I_EXIT_EBREAK == (int)EXIT_EBREAK && RV32I_EXIT_MEMORY_FAULT == (int)EXIT_MEMORY_FAULT,
+              "rv32i_exit_reason out of sync with EXIT_REASON");
+
+static_assert(RV32I_HOST_MEMCPY == (int)HOST_MEMCPY && RV32I_HOST_MEMMOVE == (int)HOST_MEMMOVE &&
+              RV32I_HOST_MEMSET == (int)HOST_MEMSET && RV32I_HOST_MEMCMP == (int)HOST_MEMCMP &&
+              RV32I_HOST_STRLEN == (int)HOST_STRLEN && RV32I_HOST_FIRST_USER == (int)HOST_FIRST_USER &&
+              RV32I_HOST_CALL_COUNT == (int)HOST_CALL_COUNT,
+              "rv32i_host_call out of sync with HOST_CALL");
+
+// Host calls get the CPU they run for as an opaque rv32i_guest
+static cpu_rv32i& guest_cpu(rv32i_guest* guest) {
+    return *reinterpret_cast<cpu_rv32i*>(guest);
+}
+
+// Loads the program, passes the 8 argument words in a0-a7 and runs to completion
+static exec_result run_program(cpu_rv32i& cpu, const prog_rv32i& prog, va_list args) {
+    cpu.load_program(prog.code);
+
     for (int i = 0; i < 8; ++i) {
         uint32_t arg = va_arg(args, uint32_t);
         cpu.write_reg(10 + i, arg); // a0 is x10
     }
-    va_end(args);
 
-    // Execute
+    return cpu.execute(prog);
+}
+
+// Like run_program, with the 8 argument words from an array
+static exec_result run_program(cpu_rv32i& cpu, const prog_rv32i& prog, const uint32_t* args) {
+    cpu.load_program(prog.code);
+
+    for (int i = 0; i < 8; ++i) {
+        cpu.write_reg(10 + i, args[i]);
+    }
+
+    return cpu.execute(prog);
+}
+
+// Like run_program, with arguments from an rv32i_arg array; buffer arguments are
+// mapped for the call and written back before returning. Throws if they don't fit.
+static exec_result run_program(cpu_rv32i& cpu, const prog_rv32i& prog, const rv32i_arg* args, size_t count) {
+    cpu.load_program(prog.code);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t arg = args[i].value;
+        if (args[i].data) {
+            if (args[i].size > mem_rv32i::MAP_SIZE) {
+                throw std::length_error("Buffer argument too large");
+            }
+            arg = cpu.memory.map_buffer(args[i].data, static_cast<uint32_t>(args[i].size), args[i].writable != 0);
+        }
+        cpu.write_reg(10 + i, arg);
+    }
+
+    exec_result result = cpu.execute(prog);
+    cpu.memory.unmap_buffers();
+    return result;
+}
+
+// Invocations a batch worker claims at a time: enough to keep the shared counter
+// cold, few enough that uneven calls still spread over the workers
+static constexpr size_t BATCH_CHUNK = 64;
+static_assert(BATCH_CHUNK % lanes_rv32i::LANES == 0, "batch chunks split into whole lockstep groups");
+
+// Runs batch invocations on one pooled CPU, claiming chunks from next until none
+// are left. Returns how many invocations faulted.
+static size_t run_batch(const prog_rv32i& prog, const uint32_t* args, size_t stride, size_t n,
+                        uint32_t* results, std::atomic<size_t>& next) {
+    size_t argc = std::min<size_t>(stride, 8);
+    size_t faults = 0;
+    cpu_lease cpu;
+    bool fresh = true;  // leased CPUs come reset
+
+    for (;;) {
+        size_t first = next.fetch_add(BATCH_CHUNK, std::memory_order_relaxed);
+        if (first >= n) {
+            break;
+        }
+        size_t last = std::min(n, first + BATCH_CHUNK);
+        size_t k = first;
+        try {
+            for (; k < last; ++k) {
+                if (!fresh) {
+                    cpu->reset();
+                }
+                fresh = false;
+                cpu->load_program(prog.code);
+                const uint32_t* tuple = args + k * stride;
+                for (size_t i = 0; i < argc; ++i) {
+                    cpu->write_reg(10 + i, tuple[i]);
+                }
+                if (cpu->execute(prog).reason == EXIT_RETURN) {
+                    results[k] = cpu->read_reg(10);
+                } else {
+                    results[k] = 0;
+                    faults++;
+                }
+            }
+        } catch (const std::exception&) {
+            // The CPU can't take the program: the rest of the chunk faults and
+            // the other workers take the chunks left
+            std::fill(results + k, results + last, 0);
+            return faults + (last - k);
+        }
+    }
+    return faults;
+}
+
+// run_batch for programs in lockstep mode: a chunk goes through the thread's lanes
+// a group at a time
+static size_t run_batch_lanes(const prog_rv32i& prog, const uint32_t* args, size_t stride, size_t n,
+                              uint32_t* results, std::atomic<size_t>& next) {
+    static thread_local std::unique_ptr<lanes_rv32i> lanes;
+    if (!lanes) {
+        lanes = std::make_unique<lanes_rv32i>();
+    }
+    size_t faults = 0;
+
+    for (;;) {
+        size_t first = next.fetch_add(BATCH_CHUNK, std::memory_order_relaxed);
+        if (first >= n) {
+            break;
+        }
+        size_t last = std::min(n, first + BATCH_CHUNK);
+        size_t k = first;
+        try {
+            for (; k < last; k += lanes_rv32i::LANES) {
+                size_t count = std::min(lanes_rv32i::LANES, last - k);
+                faults += lanes->run(prog, args + k * stride, stride, count, results + k);
+            }
+        } catch (const std::exception&) {
+            std::fill(results + k, results + last, 0);
+            return faults + (last - k);
+        }
+    }
+    return faults;
+}
+
+// Threads rv32i_call_batch_threads runs its extra workers on. They live until the
+// process exits, so the CPUs and lanes they lease stay warm from one batch to the
+// next instead of every batch building (or, with reserved memory, mapping) fresh
+// ones on new threads. They serve one batch at a time.
+class batch_helpers {
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable finished;
+    std::function<void()> job;
+    uint64_t generation = 0;    // bumped for each job
+    unsigned wanted = 0;        // helpers 0..wanted-1 run the current job
+    unsigned running = 0;       // of those, not done yet
+    unsigned started = 0;
+
+    void work(unsigned self) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;) {
+            start.wait(guard, [&]() { return generation != seen; });
+            seen = generation;
+            if (self >= wanted) {
+                continue;
+            }
+            guard.unlock();
+            job();
+            guard.lock();
+            if (--running == 0) {
+                finished.notify_all();
+            }
+        }
+    }
+
+public:
+    std::mutex busy;    // held by the batch the helpers are serving
+
+    // Starts task on up to count helpers, starting threads as needed; returns how many run it
+    unsigned run(unsigned count, std::function<void()> task) {
+        std::lock_guard<std::mutex> guard(lock);
+        while (started < count) {
+            try {
+                std::thread(&batch_helpers::work, this, started).detach();
+            } catch (const std::system_error&) {
+                break;
+            }
+            started++;
+        }
+        job = std::move(task);
+        wanted = std::min(count, started);
+        running = wanted;
+        generation++;
+        start.notify_all();
+        return wanted;
+    }
+
+    // Waits until the helpers have finished the task from run()
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this]() { return running == 0; });
+    }
+};
+
+// The plain entry points report faults on stderr and return 0
+static bool succeeded(const exec_result& result) {
+    if (result.reason != EXIT_RETURN) {
+        std::cerr << "Emulator error: " << describe(result) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static uint64_t result64(const cpu_rv32i& cpu) {
+    uint64_t lo = cpu.read_reg(10);
+    uint64_t hi = cpu.read_reg(11);
+    return lo | (hi << 32);
+}
+
+// Fills in an _ex result; returns the _ex status code
+static int report(rv32i_result* out, const exec_result& result, uint64_t value) {
+    out->reason = static_cast<rv32i_exit_reason>(result.reason);
+    out->pc = result.pc;
+    out->addr = result.addr;
+    out->value = result.reason == EXIT_RETURN ? value : 0;
+    return result.reason == EXIT_RETURN ? 0 : -1;
+}
+
+static int report(rv32i_result* out, const exec_result& result, const cpu_rv32i& cpu) {
+    return report(out, result, result64(cpu));
+}
+
+// Shared body of the plain entry points: runs prog on a leased CPU with args as
+// run_program takes them. Faults, and a CPU or arguments that can't be set up, are
+// printed and return 0.
+template <typename... Args>
+static uint64_t invoke_plain(const prog_rv32i& prog, Args&&... args) {
     try {
-        cpu.execute(instructions);
+        cpu_lease cpu;
+        bool ok = succeeded(run_program(*cpu, prog, std::forward<Args>(args)...));
+        return ok ? result64(*cpu) : 0;
     } catch (const std::exception& e) {
         std::cerr << "Emulator error: " << e.what() << std::endl;
         return 0;
     }
+}
 
-    return cpu.read_reg(10); // return a0
+// Shared body of the _ex entry points: runs prog on a leased CPU and reports how it
+// stopped. A CPU that can't be set up is RV32I_EXIT_NO_MEMORY, buffer arguments that
+// don't fit the guest window are RV32I_EXIT_INVALID_ARGUMENT.
+template <typename... Args>
+static int invoke_ex(rv32i_result* result, const prog_rv32i& prog, Args&&... args) {
+    try {
+        cpu_lease cpu;
+        return report(result, run_program(*cpu, prog, std::forward<Args>(args)...), *cpu);
+    } catch (const std::length_error&) {
+        *result = {RV32I_EXIT_INVALID_ARGUMENT, 0, 0, 0};
+    } catch (const std::exception&) {
+        *result = {RV32I_EXIT_NO_MEMORY, 0, 0, 0};
+    }
+    return -1;
 }
 
-uint64_t rv32i_call64(const uint8_t* bytecode, size_t size, ...) {
-    cpu_rv32i cpu;
-
-    // Load program into memory
-    std::vector<uint8_t> code(bytecode, bytecode + size);
-    deobfuscate(code); // Restore obfuscated code
-    cpu.load_program(code);
-
-    // Decode instructions from the restored code
-    std::vector<std::unique_ptr<Instruction>> instructions;
-    for (size_t i = 0; i < code.size(); i += 4) {
-        uint32_t raw = 0;
-        if (i + 4 <= code.size()) {
-            // Read from restored code (little-endian)
-            raw = code[i] | (code[i+1] << 8) | (code[i+2] << 16) | (code[i+3] << 24);
-        } else {
-            memcpy(&raw, code.data() + i, code.size() - i);
-        }
-        instructions.push_back(decodeInstruction(raw));
+// Shared body of the fixed-arity entry points
+static uint64_t invoke_regs(rv32i_program* program, const uint32_t* args) {
+    if (!program) return 0;
+    return invoke_plain(program->prog, args);
+}
+
+// Decodes bytecode for the plain one-shot entry points; reports why it can't
+static std::unique_ptr<prog_rv32i> decode(const uint8_t* bytecode, size_t size) {
+    try {
+        return std::make_unique<prog_rv32i>(bytecode, size);
+    } catch (const std::exception& e) {
+        std::cerr << "Emulator error: " << e.what() << std::endl;
+        return nullptr;
     }
+}
+
+extern "C" {
+
+uint32_t rv32i_call(const uint8_t* bytecode, size_t size, ...) {
+    std::unique_ptr<prog_rv32i> prog = decode(bytecode, size);
+    if (!prog) return 0;
 
-    // Set arguments
     va_list args;
     va_start(args, size);
-    for (int i = 0; i < 8; ++i) {
-        uint32_t arg = va_arg(args, uint32_t);
-        cpu.write_reg(10 + i, arg); // a0 is x10
+    uint64_t value = invoke_plain(*prog, args);
+    va_end(args);
+
+    return static_cast<uint32_t>(value); // a0
+}
+
+uint64_t rv32i_call64(const uint8_t* bytecode, size_t size, ...) {
+    std::unique_ptr<prog_rv32i> prog = decode(bytecode, size);
+    if (!prog) return 0;
+
+    va_list args;
+    va_start(args, size);
+    uint64_t value = invoke_plain(*prog, args);
+    va_end(args);
+
+    return value;
+}
+
+int rv32i_call_ex(const uint8_t* bytecode, size_t size, rv32i_result* result, ...) {
+    if (!result) return -1;
+    std::unique_ptr<prog_rv32i> prog;
+    try {
+        prog = std::make_unique<prog_rv32i>(bytecode, size);
+    } catch (const std::exception&) {
+        *result = {RV32I_EXIT_INVALID_PROGRAM, 0, 0, 0};
+        return -1;
     }
+
+    va_list args;
+    va_start(args, result);
+    int status = invoke_ex(result, *prog, args);
     va_end(args);
 
-    // Execute
+    return status;
+}
+
+rv32i_program* rv32i_prepare(const uint8_t* bytecode, size_t size) {
     try {
-        cpu.execute(instructions);
+        return new rv32i_program{prog_rv32i(bytecode, size)};
     } catch (const std::exception& e) {
         std::cerr << "Emulator error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+uint32_t rv32i_invoke(rv32i_program* program, ...) {
+    if (!program) return 0;
+
+    va_list args;
+    va_start(args, program);
+    uint64_t value = invoke_plain(program->prog, args);
+    va_end(args);
+
+    return static_cast<uint32_t>(value); // a0
+}
+
+uint64_t rv32i_invoke64(rv32i_program* program, ...) {
+    if (!program) return 0;
+
+    va_list args;
+    va_start(args, program);
+    uint64_t value = invoke_plain(program->prog, args);
+    va_end(args);
+
+    return value;
+}
+
+int rv32i_invoke_ex(rv32i_program* program, rv32i_result* result, ...) {
+    if (!program || !result) return -1;
+
+    va_list args;
+    va_start(args, result);
+    int status = invoke_ex(result, program->prog, args);
+    va_end(args);
+
+    return status;
+}
+
+uint64_t rv32i_invoke0(rv32i_program* program) {
+    const uint32_t args[8] = {};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke1(rv32i_program* program, uint32_t a0) {
+    const uint32_t args[8] = {a0};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke2(rv32i_program* program, uint32_t a0, uint32_t a1) {
+    const uint32_t args[8] = {a0, a1};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke3(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2) {
+    const uint32_t args[8] = {a0, a1, a2};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke4(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    const uint32_t args[8] = {a0, a1, a2, a3};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke5(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4) {
+    const uint32_t args[8] = {a0, a1, a2, a3, a4};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke6(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5) {
+    const uint32_t args[8] = {a0, a1, a2, a3, a4, a5};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke7(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5, uint32_t a6) {
+    const uint32_t args[8] = {a0, a1, a2, a3, a4, a5, a6};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke8(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5, uint32_t a6, uint32_t a7) {
+    const uint32_t args[8] = {a0, a1, a2, a3, a4, a5, a6, a7};
+    return invoke_regs(program, args);
+}
+
+uint64_t rv32i_invoke_regs(rv32i_program* program, const rv32i_regs* regs) {
+    if (!regs) return 0;
+    return invoke_regs(program, regs->a);
+}
+
+uint64_t rv32i_invoke_args(rv32i_program* program, const rv32i_arg* args, size_t count) {
+    if (!program || (count && !args)) return 0;
+    if (count > 8) {
+        std::cerr << "Emulator error: more than 8 arguments" << std::endl;
         return 0;
     }
+    return invoke_plain(program->prog, args, count);
+}
 
-    uint64_t lo = cpu.read_reg(10);
-    uint64_t hi = cpu.read_reg(11);
-    return lo | (hi << 32);
+int rv32i_invoke_args_ex(rv32i_program* program, const rv32i_arg* args, size_t count, rv32i_result* result) {
+    if (!program || !result) return -1;
+    if (count > 8 || (count && !args)) {
+        *result = {RV32I_EXIT_INVALID_ARGUMENT, 0, 0, 0};
+        return -1;
+    }
+    return invoke_ex(result, program->prog, args, count);
+}
+
+int rv32i_call_batch(rv32i_program* program, const uint32_t* args, size_t stride, size_t n, uint32_t* results) {
+    return rv32i_call_batch_threads(program, args, stride, n, results, 1);
+}
+
+int rv32i_call_batch_threads(rv32i_program* program, const uint32_t* args, size_t stride, size_t n,
+                             uint32_t* results, unsigned threads) {
+    if (!program || (n && (!results || (stride && !args)))) return -1;
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(chunks, 1)));
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> faults{0};
+    auto work = [&]() {
+        try {
+            faults += program->lockstep ? run_batch_lanes(program->prog, args, stride, n, results, next)
+                                        : run_batch(program->prog, args, stride, n, results, next);
+        } catch (const std::exception&) {
+            // No CPU for this worker; the others take its share
+        }
+    };
+
+    // The calling thread is one of the workers. Never destroyed, since its threads
+    // run until exit; a batch started while another has them (from a host call, say)
+    // runs on its calling thread alone.
+    static batch_helpers* helpers = new batch_helpers;
+    std::unique_lock<std::mutex> busy(helpers->busy, std::defer_lock);
+    unsigned helping = 0;
+    if (threads > 1 && busy.try_lock()) {
+        helping = helpers->run(threads - 1, work);
+    }
+    work();
+    if (helping) {
+        helpers->wait();
+    }
+
+    // Invocations left unclaimed because no worker could get a CPU
+    size_t claimed = std::min(next.load(), n);
+    if (claimed < n) {
+        std::fill(results + claimed, results + n, 0);
+        faults += n - claimed;
+    }
+    return faults.load() == 0 ? 0 : -1;
+}
+
+void rv32i_set_lockstep(rv32i_program* program, int enable) {
+    if (program) program->lockstep = enable != 0;
+}
+
+rv32i_pool* rv32i_pool_create(const rv32i_pool_config* config) {
+    unsigned workers = config ? config->workers : 0;
+    std::vector<int> cpus;
+    if (config && config->affinity) {
+        if (workers == 0) return nullptr;
+        cpus.assign(config->affinity, config->affinity + workers);
+    }
+    try {
+        return new rv32i_pool(workers, cpus);
+    } catch (const std::exception& e) {
+        std::cerr << "Emulator error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void rv32i_pool_destroy(rv32i_pool* pool) {
+    delete pool;
+}
+
+rv32i_future* rv32i_submit(rv32i_pool* pool, rv32i_program* program, const uint32_t* args, size_t count) {
+    if (!pool || !program || count > 8 || (count && !args)) return nullptr;
+    auto call = std::make_shared<pool_call>();
+    call->prog = &program->prog;
+    std::copy(args, args + count, call->args);
+    pool->pool.submit(call);
+    return new rv32i_future{std::move(call)};
+}
+
+int rv32i_future_ready(const rv32i_future* future) {
+    return future && future->call->ready() ? 1 : 0;
+}
+
+int rv32i_future_wait(rv32i_future* future, rv32i_result* result) {
+    if (!future || !result) return -1;
+    future->call->wait();
+    if (future->call->failed) {
+        *result = {RV32I_EXIT_NO_MEMORY, 0, 0, 0};
+        return -1;
+    }
+    return report(result, future->call->result, future->call->value);
+}
+
+uint32_t rv32i_future_get(rv32i_future* future) {
+    if (!future) return 0;
+    future->call->wait();
+    if (future->call->failed) {
+        std::cerr << "Emulator error: Failed to set up guest memory" << std::endl;
+        return 0;
+    }
+    return succeeded(future->call->result) ? static_cast<uint32_t>(future->call->value) : 0;
+}
+
+void rv32i_future_release(rv32i_future* future) {
+    delete future;
+}
+
+int rv32i_pool_get_stats(const rv32i_pool* pool, rv32i_pool_stats* stats) {
+    if (!pool || !stats) return -1;
+    const pool_rv32i& p = pool->pool;
+    stats->workers = static_cast<unsigned>(p.workers());
+    stats->submitted = p.submitted();
+    stats->completed = 0;
+    stats->stolen = 0;
+    for (size_t k = 0; k < p.workers(); ++k) {
+        pool_rv32i::worker_stats worker = p.get_worker_stats(k);
+        stats->completed += worker.completed;
+        stats->stolen += worker.stolen;
+    }
+    stats->queued = p.queued();
+    stats->peak_queued = p.peak_queued();
+    return 0;
+}
+
+int rv32i_pool_get_worker_stats(const rv32i_pool* pool, unsigned worker, rv32i_worker_stats* stats) {
+    if (!pool || !stats || worker >= pool->pool.workers()) return -1;
+    pool_rv32i::worker_stats w = pool->pool.get_worker_stats(worker);
+    stats->queued = w.queued;
+    stats->completed = w.completed;
+    stats->stolen = w.stolen;
+    stats->cpu = w.cpu;
+    return 0;
+}
+
+void rv32i_set_jit_threshold(rv32i_program* program, uint32_t executions) {
+    if (program) program->prog.jit_threshold = executions;
+}
+
+int rv32i_get_block_stats(const rv32i_program* program, rv32i_block_stats* stats) {
+    if (!program || !stats) return -1;
+    const prog_rv32i& prog = program->prog;
+    std::lock_guard<std::mutex> guard(prog.lock);
+
+    uint64_t covered = 0;
+    uint64_t native = 0;
+    for (const block_rv32i& blk : prog.blocks) {
+        covered += blk.length;
+        if (blk.native) native++;
+    }
+
+    stats->blocks = prog.blocks.size();
+    stats->avg_block_length = stats->blocks ? (double)covered / stats->blocks : 0.0;
+    stats->transitions = prog.block_transitions;
+    stats->chain_hits = prog.chain_hits;
+    stats->chain_hit_rate = stats->transitions ? (double)stats->chain_hits / stats->transitions : 0.0;
+    stats->native_blocks = native;
+    return 0;
+}
+
+int rv32i_register_host_call(uint32_t number, rv32i_host_fn fn, void* user) {
+    return register_host_call(number, fn, user) ? 0 : -1;
+}
+
+int rv32i_allow_host_call(rv32i_program* program, uint32_t number) {
+    if (!program || number >= HOST_CALL_COUNT) return -1;
+    program->prog.host_calls.set(number);
+    return 0;
+}
+
+void rv32i_guest_read(rv32i_guest* guest, uint32_t addr, void* dst, size_t len) {
+    guest_cpu(guest).memory.read_block(addr, dst, static_cast<uint32_t>(len));
+}
+
+void rv32i_guest_write(rv32i_guest* guest, uint32_t addr, const void* src, size_t len) {
+    guest_cpu(guest).memory.write_block(addr, src, static_cast<uint32_t>(len));
+}
+
+void* rv32i_guest_ptr(rv32i_guest* guest, uint32_t addr, size_t len) {
+    uint32_t n;
+    uint8_t* host = guest_cpu(guest).memory.writable_span(addr, static_cast<uint32_t>(len), n);
+    return n == len ? host : nullptr;
+}
+
+void rv32i_release(rv32i_program* program) {
+    delete program;
 }
 
 }
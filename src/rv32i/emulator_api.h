@@ -8,6 +8,63 @@
 extern "C" { // Has to be C callable since the target programs are C
 #endif
 
+// Opaque handle to bytecode that has already been restored and decoded
+typedef struct rv32i_program rv32i_program;
+
+// Basic-block cache statistics of a prepared program
+typedef struct {
+    uint64_t blocks;            // basic blocks built so far
+    double avg_block_length;    // instructions per block
+    uint64_t transitions;       // block-to-block transitions executed
+    uint64_t chain_hits;        // transitions that followed a cached successor link
+    double chain_hit_rate;      // chain_hits / transitions
+    uint64_t native_blocks;     // blocks translated by the JIT
+} rv32i_block_stats;
+
+// The guest CPU a host call runs for, used to reach its memory
+typedef struct rv32i_guest rv32i_guest;
+
+// Native function a guest calls with ECALL. args holds a0-a5 and the return value
+// goes back in a0. Pointer arguments are guest addresses: access them through
+// rv32i_guest_read/rv32i_guest_write/rv32i_guest_ptr.
+typedef uint32_t (*rv32i_host_fn)(rv32i_guest* guest, const uint32_t* args, void* user);
+
+// Host call numbers, passed in a7. The built-in helpers run natively on guest
+// memory; numbers from RV32I_HOST_FIRST_USER below RV32I_HOST_CALL_COUNT are free
+// for rv32i_register_host_call.
+typedef enum {
+    RV32I_HOST_MEMCPY = 1,      // memcpy(dst, src, n), returns dst
+    RV32I_HOST_MEMMOVE,         // memmove(dst, src, n), returns dst
+    RV32I_HOST_MEMSET,          // memset(dst, byte, n), returns dst
+    RV32I_HOST_MEMCMP,          // memcmp(a, b, n), returns -1, 0 or 1
+    RV32I_HOST_STRLEN,          // strlen(s)
+    RV32I_HOST_FIRST_USER = 64,
+    RV32I_HOST_CALL_COUNT = 256
+} rv32i_host_call;
+
+// Why a call stopped
+typedef enum {
+    RV32I_EXIT_RETURN,              // the guest returned normally
+    RV32I_EXIT_PC_UNDERFLOW,        // jump before the first instruction
+    RV32I_EXIT_PC_MISALIGNED,       // jump to an odd pc or into a 4-byte instruction
+    RV32I_EXIT_PC_OVERFLOW,         // jump or fall past the last instruction
+    RV32I_EXIT_ILLEGAL_INSTRUCTION, // reached a word that does not decode
+    RV32I_EXIT_ECALL,               // ECALL to a host call the program may not make
+    RV32I_EXIT_EBREAK,
+    RV32I_EXIT_MEMORY_FAULT,        // access outside guest memory
+    RV32I_EXIT_INVALID_PROGRAM,     // the bytecode could not be decoded, nothing ran
+    RV32I_EXIT_INVALID_ARGUMENT,    // arguments could not be passed (see rv32i_invoke_args), nothing ran
+    RV32I_EXIT_NO_MEMORY            // guest memory could not be set up, nothing ran
+} rv32i_exit_reason;
+
+// Outcome of a call made through one of the _ex entry points
+typedef struct {
+    rv32i_exit_reason reason;
+    uint32_t pc;        // guest pc of the RET or faulting instruction (for a bad jump, the jump)
+    uint32_t addr;      // bad jump target, faulting guest address, or refused host call number
+    uint64_t value;     // a0 (low) and a1 (high) when the guest returned
+} rv32i_result;
+
 // Execute RV32I bytecode with the given arguments
 // Returns the value in a0
 uint32_t rv32i_call(const uint8_t* bytecode, size_t size, ...);
@@ -16,6 +73,194 @@ uint32_t rv32i_call(const uint8_t* bytecode, size_t size, ...);
 // Returns the value in a0 (low) and a1 (high) combined
 uint64_t rv32i_call64(const uint8_t* bytecode, size_t size, ...);
 
+// Execute RV32I bytecode with the given arguments and report how it stopped in
+// *result. Returns 0 if the guest returned, -1 on a fault or if result is NULL.
+// Faults are not printed; guest memory that can't be set up is reported as
+// RV32I_EXIT_NO_MEMORY.
+int rv32i_call_ex(const uint8_t* bytecode, size_t size, rv32i_result* result, ...);
+
+// Restore and decode RV32I bytecode once for repeated invocation
+// Returns NULL if the bytecode cannot be decoded
+rv32i_program* rv32i_prepare(const uint8_t* bytecode, size_t size);
+
+// Execute a prepared program with the given arguments
+// Returns the value in a0
+uint32_t rv32i_invoke(rv32i_program* program, ...);
+
+// Execute a prepared program with the given arguments
+// Returns the value in a0 (low) and a1 (high) combined
+uint64_t rv32i_invoke64(rv32i_program* program, ...);
+
+// Execute a prepared program with the given arguments and report how it stopped
+// in *result. Returns 0 if the guest returned, -1 on a fault or if program or
+// result is NULL. Faults are not printed; guest memory that can't be set up is
+// reported as RV32I_EXIT_NO_MEMORY.
+int rv32i_invoke_ex(rv32i_program* program, rv32i_result* result, ...);
+
+// Argument registers of rv32i_invoke_regs
+typedef struct {
+    uint32_t a[8];      // a0-a7
+} rv32i_regs;
+
+// Execute a prepared program with exactly N arguments in a0 up, the other argument
+// registers zero. Unlike the variadic rv32i_invoke these receive their arguments in
+// host registers, so a call costs the caller a few register moves.
+// Returns the value in a0 (low) and a1 (high) combined; faults are printed and
+// return 0, as rv32i_invoke
+uint64_t rv32i_invoke0(rv32i_program* program);
+uint64_t rv32i_invoke1(rv32i_program* program, uint32_t a0);
+uint64_t rv32i_invoke2(rv32i_program* program, uint32_t a0, uint32_t a1);
+uint64_t rv32i_invoke3(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2);
+uint64_t rv32i_invoke4(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+uint64_t rv32i_invoke5(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4);
+uint64_t rv32i_invoke6(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5);
+uint64_t rv32i_invoke7(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5, uint32_t a6);
+uint64_t rv32i_invoke8(rv32i_program* program, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3,
+                       uint32_t a4, uint32_t a5, uint32_t a6, uint32_t a7);
+
+// Execute a prepared program with a0-a7 taken from regs, as rv32i_invoke0..8
+uint64_t rv32i_invoke_regs(rv32i_program* program, const rv32i_regs* regs);
+
+// Argument of rv32i_invoke_args: a plain value, or a host buffer the guest gets a
+// pointer to. Buffers appear in a window of guest memory for the duration of the
+// call; with paged guest memory the pages a buffer fully covers are shared with the
+// guest rather than copied, so passing one costs at most two pages of copying.
+typedef struct {
+    void* data;         // host buffer, or NULL for a plain value
+    size_t size;        // buffer length in bytes
+    uint32_t value;     // the argument when data is NULL
+    int writable;       // nonzero if the guest's stores must reach the buffer; stores
+                        // to a read-only buffer are discarded
+} rv32i_arg;
+
+// Execute a prepared program with up to 8 arguments in a0-a7, mapping buffer
+// arguments into guest memory; writes to writable buffers are in place when it
+// returns. Returns the value in a0 (low) and a1 (high) combined
+uint64_t rv32i_invoke_args(rv32i_program* program, const rv32i_arg* args, size_t count);
+
+// rv32i_invoke_args reporting how the call stopped in *result, as rv32i_invoke_ex.
+// Fails with RV32I_EXIT_INVALID_ARGUMENT for more than 8 arguments or buffers that
+// don't fit the guest window, and with RV32I_EXIT_NO_MEMORY as rv32i_invoke_ex.
+int rv32i_invoke_args_ex(rv32i_program* program, const rv32i_arg* args, size_t count, rv32i_result* result);
+
+// Execute a prepared program n times, once per argument tuple: tuple k starts at
+// args[k * stride] and its first stride words (at most 8) go in a0-a7. results[k]
+// receives a0, or 0 if that invocation faulted. All invocations run on one CPU
+// context with the decoded program shared, so a call costs only the guest's own
+// work. Returns 0 if every invocation returned, -1 if any faulted or on bad
+// arguments. Faults are not printed.
+int rv32i_call_batch(rv32i_program* program, const uint32_t* args, size_t stride, size_t n, uint32_t* results);
+
+// rv32i_call_batch spread over up to threads threads, each with its own CPU
+// context; 0 uses one per hardware thread. Small batches use fewer threads. The
+// extra threads are kept for later batches, along with their CPU contexts.
+int rv32i_call_batch_threads(rv32i_program* program, const uint32_t* args, size_t stride, size_t n,
+                             uint32_t* results, unsigned threads);
+
+// Run this program's batch calls 8 at a time in lockstep: each instruction is
+// decoded once for all 8 and applied with vector operations, and calls that branch
+// apart wait for each other to meet again. Suits functions whose control flow
+// depends little on their arguments. 0 turns it back off (the default).
+void rv32i_set_lockstep(rv32i_program* program, int enable);
+
+// Pool of worker threads for asynchronous calls; each worker has its own CPU
+// context and queue, and idle workers steal queued calls from busy ones
+typedef struct rv32i_pool rv32i_pool;
+
+// Pending outcome of a call made with rv32i_submit
+typedef struct rv32i_future rv32i_future;
+
+// Settings of rv32i_pool_create
+typedef struct {
+    unsigned workers;       // worker threads, 0 for one per hardware thread
+    const int* affinity;    // host CPU to pin each worker to (-1 leaves it unpinned), one
+                            // entry per worker, or NULL; needs workers set. Linux only.
+} rv32i_pool_config;
+
+// Pool-wide statistics
+typedef struct {
+    unsigned workers;
+    uint64_t submitted;     // calls submitted so far
+    uint64_t completed;     // calls run so far
+    uint64_t stolen;        // calls a worker took from another worker's queue
+    uint64_t queued;        // calls waiting for a worker right now
+    uint64_t peak_queued;   // most calls ever waiting at once
+} rv32i_pool_stats;
+
+// Statistics of one pool worker
+typedef struct {
+    uint64_t queued;        // calls waiting in its queue
+    uint64_t completed;     // calls it ran
+    uint64_t stolen;        // of those, taken from another worker's queue
+    int cpu;                // host CPU it is pinned to, or -1
+} rv32i_worker_stats;
+
+// Start a pool; config may be NULL for one unpinned worker per hardware thread.
+// Returns NULL if the workers can't be started.
+rv32i_pool* rv32i_pool_create(const rv32i_pool_config* config);
+
+// Run the calls still queued, then stop the workers and free the pool. Futures
+// stay valid until released.
+void rv32i_pool_destroy(rv32i_pool* pool);
+
+// Queue a call of a prepared program with count (at most 8) arguments in a0-a7 and
+// return at once. The program must outlive the call; args are copied. A host call
+// must not wait for a call it submitted to the pool it runs on. Returns NULL on bad
+// arguments.
+rv32i_future* rv32i_submit(rv32i_pool* pool, rv32i_program* program, const uint32_t* args, size_t count);
+
+// Returns 1 if the call has finished, 0 if it is still queued or running
+int rv32i_future_ready(const rv32i_future* future);
+
+// Wait for the call and report how it stopped in *result, as rv32i_invoke_ex
+int rv32i_future_wait(rv32i_future* future, rv32i_result* result);
+
+// Wait for the call and return its a0, as rv32i_invoke
+uint32_t rv32i_future_get(rv32i_future* future);
+
+// Free a future; the call still runs if it hasn't yet
+void rv32i_future_release(rv32i_future* future);
+
+// Fill in pool-wide or per-worker statistics
+// Returns 0 on success, -1 for a NULL argument or a worker out of range
+int rv32i_pool_get_stats(const rv32i_pool* pool, rv32i_pool_stats* stats);
+int rv32i_pool_get_worker_stats(const rv32i_pool* pool, unsigned worker, rv32i_worker_stats* stats);
+
+// Set how many times a basic block runs before the JIT translates it (0 disables
+// the JIT for this program). Has no effect in builds without the JIT.
+void rv32i_set_jit_threshold(rv32i_program* program, uint32_t executions);
+
+// Fill in the basic-block statistics of a prepared program
+// Returns 0 on success, -1 if program or stats is NULL
+int rv32i_get_block_stats(const rv32i_program* program, rv32i_block_stats* stats);
+
+// Register fn as host call number (RV32I_HOST_FIRST_USER and up), replacing any
+// earlier function; NULL removes it. user is passed back to every call. Register
+// calls before guests make them. Returns 0 on success, -1 for a reserved number.
+int rv32i_register_host_call(uint32_t number, rv32i_host_fn fn, void* user);
+
+// Let a prepared program make host call number; an ECALL to any call it was not
+// allowed stops it with RV32I_EXIT_ECALL. Allow calls before the program first runs.
+// Returns 0 on success, -1 if program is NULL or number is out of range.
+int rv32i_allow_host_call(rv32i_program* program, uint32_t number);
+
+// Copy between guest memory and the host, for use inside host calls. With reserved
+// guest memory, touching an address outside the guest's regions abandons the host
+// call and stops the guest with RV32I_EXIT_MEMORY_FAULT.
+void rv32i_guest_read(rv32i_guest* guest, uint32_t addr, void* dst, size_t len);
+void rv32i_guest_write(rv32i_guest* guest, uint32_t addr, const void* src, size_t len);
+
+// Host address of guest range [addr, addr + len) for direct access, or NULL when
+// the range is not contiguous in host memory (paged guest memory splits it at 4 KiB
+// pages); fall back to rv32i_guest_read/rv32i_guest_write then
+void* rv32i_guest_ptr(rv32i_guest* guest, uint32_t addr, size_t len);
+
+// Free a prepared program
+void rv32i_release(rv32i_program* program);
+
 #ifdef __cplusplus
 }
 #endif
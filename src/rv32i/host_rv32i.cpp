@@ -0,0 +1,70 @@
+#include "host_rv32i.h"
+#include "cpu_rv32i.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Registered user calls. Entries are set once at startup and read on every ECALL,
+// so each field is an atomic of its own rather than sitting behind a lock.
+struct host_entry {
+    std::atomic<rv32i_host_fn> fn{nullptr};
+    std::atomic<void*> user{nullptr};
+};
+
+static host_entry user_calls[HOST_CALL_COUNT];
+
+const char* host_call_name(uint32_t number) {
+    switch (number) {
+        case HOST_MEMCPY: return "memcpy";
+        case HOST_MEMMOVE: return "memmove";
+        case HOST_MEMSET: return "memset";
+        case HOST_MEMCMP: return "memcmp";
+        case HOST_STRLEN: return "strlen";
+        default: return nullptr;
+    }
+}
+
+bool register_host_call(uint32_t number, rv32i_host_fn fn, void* user) {
+    if (number < HOST_FIRST_USER || number >= HOST_CALL_COUNT) {
+        return false;
+    }
+    host_entry& entry = user_calls[number];
+    entry.user.store(user, std::memory_order_relaxed);
+    entry.fn.store(fn, std::memory_order_release);
+    return true;
+}
+
+bool run_host_call(cpu_rv32i& cpu, uint32_t number) {
+    uint32_t* a = &cpu.registers[10];   // a0-a5
+    mem_rv32i& mem = cpu.memory;
+    switch (number) {
+        case HOST_MEMCPY:       // memmove covers memcpy; a0 already holds dst
+        case HOST_MEMMOVE:
+            mem.move_block(a[0], a[1], a[2]);
+            return true;
+        case HOST_MEMSET:
+            mem.fill_block(a[0], static_cast<uint8_t>(a[1]), a[2]);
+            return true;
+        case HOST_MEMCMP:
+            a[0] = static_cast<uint32_t>(mem.compare_block(a[0], a[1], a[2]));
+            return true;
+        case HOST_STRLEN:
+            a[0] = mem.string_length(a[0]);
+            return true;
+        default:
+            break;
+    }
+
+    if (number >= HOST_CALL_COUNT) {
+        return false;
+    }
+    host_entry& entry = user_calls[number];
+    rv32i_host_fn fn = entry.fn.load(std::memory_order_acquire);
+    if (!fn) {
+        return false;
+    }
+    uint32_t args[6];
+    std::copy(a, a + 6, args);
+    a[0] = fn(reinterpret_cast<rv32i_guest*>(&cpu), args, entry.user.load(std::memory_order_relaxed));
+    return true;
+}
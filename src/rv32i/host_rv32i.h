@@ -0,0 +1,37 @@
+#ifndef HOST_RV32I_H
+#define HOST_RV32I_H
+
+#include <cstdint>
+
+#include "emulator_api.h"
+
+class cpu_rv32i;
+
+// Host calls: native functions a guest reaches with ECALL, passing the call number
+// in a7 and arguments in a0-a5 and getting the result back in a0. Numbers below
+// HOST_FIRST_USER are built-in helpers that work on guest memory a span at a time;
+// the rest are registered by the embedder. A program may only make the calls it
+// was allowed (see prog_rv32i::host_calls).
+enum HOST_CALL : uint32_t {
+    HOST_MEMCPY = 1,    // memcpy(dst, src, n), returns dst
+    HOST_MEMMOVE,       // memmove(dst, src, n), returns dst
+    HOST_MEMSET,        // memset(dst, byte, n), returns dst
+    HOST_MEMCMP,        // memcmp(a, b, n), returns -1, 0 or 1
+    HOST_STRLEN,        // strlen(s)
+    HOST_FIRST_USER = 64,
+    HOST_CALL_COUNT = 256
+};
+
+// Name of a built-in call, e.g. "memcpy"; nullptr for any other number
+const char* host_call_name(uint32_t number);
+
+// Installs fn as user call number, replacing any earlier one (nullptr removes it).
+// Returns false for built-in and out-of-range numbers. Don't replace a call while
+// guests may be making it.
+bool register_host_call(uint32_t number, rv32i_host_fn fn, void* user);
+
+// Runs call number for cpu, leaving its result in a0; returns false if no call is
+// registered under that number
+bool run_host_call(cpu_rv32i& cpu, uint32_t number);
+
+#endif //HOST_RV32I_H
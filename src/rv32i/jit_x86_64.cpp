@@ -0,0 +1,300 @@
+#include "jit_x86_64.h"
+#include "mem_rv32i.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Memory callbacks used by translated loads and stores
+static uint32_t jit_lb(mem_rv32i* m, uint32_t addr)  { return (uint32_t)(int32_t)(int8_t)m->read8(addr); }
+static uint32_t jit_lh(mem_rv32i* m, uint32_t addr)  { return (uint32_t)(int32_t)(int16_t)m->read16(addr); }
+static uint32_t jit_lw(mem_rv32i* m, uint32_t addr)  { return m->read32(addr); }
+static uint32_t jit_lbu(mem_rv32i* m, uint32_t addr) { return m->read8(addr); }
+static uint32_t jit_lhu(mem_rv32i* m, uint32_t addr) { return m->read16(addr); }
+static void jit_sb(mem_rv32i* m, uint32_t addr, uint32_t val) { m->write8(addr, (uint8_t)val); }
+static void jit_sh(mem_rv32i* m, uint32_t addr, uint32_t val) { m->write16(addr, (uint16_t)val); }
+static void jit_sw(mem_rv32i* m, uint32_t addr, uint32_t val) { m->write32(addr, val); }
+
+namespace {
+
+// Host registers by encoding
+enum reg { EAX = 0, ECX = 1, EDX = 2, ESI = 6 };
+
+// Minimal x86-64 emitter for the handful of instruction forms the translator needs
+class emitter {
+public:
+    std::vector<uint8_t> code;
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> bs) { code.insert(code.end(), bs); }
+    void imm32(uint32_t v) {
+        for (int n = 0; n < 4; n++) byte((v >> (8 * n)) & 0xFF);
+    }
+    void imm64(uint64_t v) {
+        for (int n = 0; n < 8; n++) byte((v >> (8 * n)) & 0xFF);
+    }
+
+    // r = guest register g (x0 reads as 0)
+    void load_guest(reg r, uint8_t g) {
+        if (g == 0) {
+            bytes({0x31, (uint8_t)(0xC0 | (r << 3) | r)});        // xor r, r
+        } else {
+            bytes({0x8B, (uint8_t)(0x43 | (r << 3)), (uint8_t)(4 * g)});   // mov r, [rbx + 4*g]
+        }
+    }
+    // guest register g = eax (writes to x0 are dropped)
+    void store_guest(uint8_t g) {
+        if (g != 0) {
+            bytes({0x89, 0x43, (uint8_t)(4 * g)});                 // mov [rbx + 4*g], eax
+        }
+    }
+    void mov_imm(reg r, uint32_t v) {
+        byte(0xB8 + r);                                            // mov r, imm32
+        imm32(v);
+    }
+    // eax = eax <op> ecx, op is the "op r/m32, r32" opcode byte
+    void alu_rr(uint8_t op) { bytes({op, 0xC8}); }
+    // eax = eax <op> imm32, op is the "op eax, imm32" opcode byte
+    void alu_ri(uint8_t op, uint32_t v) { byte(op); imm32(v); }
+    // eax = eax shifted by cl, ext is the ModRM reg extension (0 rol, 1 ror, 4 shl, 5 shr, 7 sar)
+    void shift_cl(uint8_t ext) { bytes({0xD3, (uint8_t)(0xC0 | (ext << 3))}); }
+    void shift_imm(uint8_t ext, uint8_t n) { bytes({0xC1, (uint8_t)(0xC0 | (ext << 3)), n}); }
+    // eax = flags condition cc ? 1 : 0
+    void setcc(uint8_t cc) { bytes({0x0F, (uint8_t)(0x90 | cc), 0xC0, 0x0F, 0xB6, 0xC0}); }
+    // eax = cc ? edx : eax
+    void cmov_edx(uint8_t cc) { bytes({0x0F, (uint8_t)(0x40 | cc), 0xC2}); }
+
+    // *site = index, through the site pointer in rbp
+    void mark_site(size_t index) {
+        bytes({0x48, 0xC7, 0x45, 0x00});                           // mov qword [rbp], imm32
+        imm32(static_cast<uint32_t>(index));
+    }
+
+    // Calls fn(mem, esi, edx) with mem from r12; result in eax
+    void call_mem(const void* fn) {
+        bytes({0x4C, 0x89, 0xE7});                                 // mov rdi, r12
+        bytes({0x48, 0xB8});                                       // mov rax, fn
+        imm64(reinterpret_cast<uint64_t>(fn));
+        bytes({0xFF, 0xD0});                                       // call rax
+    }
+
+    void prologue() {
+        bytes({0x53, 0x41, 0x54, 0x55});                           // push rbx; push r12; push rbp
+        bytes({0x48, 0x89, 0xFB});                                 // mov rbx, rdi
+        bytes({0x49, 0x89, 0xF4});                                 // mov r12, rsi
+        bytes({0x48, 0x89, 0xD5});                                 // mov rbp, rdx
+    }
+    // Returns eax as the next guest pc
+    void epilogue() {
+        bytes({0x5D, 0x41, 0x5C, 0x5B, 0xC3});                     // pop rbp; pop r12; pop rbx; ret
+    }
+};
+
+// x86 condition codes
+enum cond : uint8_t { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD };
+
+} // namespace
+
+// Emits instruction index of the program at guest address pc, followed by next_pc
+// (instructions are 2 or 4 bytes); returns false if it has to be left to the
+// interpreter. Control transfers end the translation by leaving the next pc in eax.
+static bool translate(emitter& e, const DecodedInst& i, size_t index, uint32_t pc, uint32_t next_pc, bool& ended) {
+    ended = false;
+    switch (i.op) {
+        case LUI:
+            e.mov_imm(EAX, i.imm); e.store_guest(i.rd); return true;
+        case AUIPC:
+            e.mov_imm(EAX, pc + i.imm); e.store_guest(i.rd); return true;
+
+        case ADDI: case XORI: case ORI: case ANDI: case SLTI: case SLTIU:
+        case SLLI: case SRLI: case SRAI:
+            e.load_guest(EAX, i.rs1);
+            switch (i.op) {
+                case ADDI:  e.alu_ri(0x05, i.imm); break;
+                case XORI:  e.alu_ri(0x35, i.imm); break;
+                case ORI:   e.alu_ri(0x0D, i.imm); break;
+                case ANDI:  e.alu_ri(0x25, i.imm); break;
+                case SLTI:  e.alu_ri(0x3D, i.imm); e.setcc(CC_L); break;
+                case SLTIU: e.alu_ri(0x3D, i.imm); e.setcc(CC_B); break;
+                case SLLI:  e.shift_imm(4, i.imm & 0x1F); break;
+                case SRLI:  e.shift_imm(5, i.imm & 0x1F); break;
+                case SRAI:  e.shift_imm(7, i.imm & 0x1F); break;
+            }
+            e.store_guest(i.rd);
+            return true;
+
+        case ADD: case SUB: case AND: case OR: case XOR: case SLT: case SLTU:
+        case SLL: case SRL: case SRA:
+            e.load_guest(EAX, i.rs1);
+            e.load_guest(ECX, i.rs2);
+            switch (i.op) {
+                case ADD:  e.alu_rr(0x01); break;
+                case SUB:  e.alu_rr(0x29); break;
+                case AND:  e.alu_rr(0x21); break;
+                case OR:   e.alu_rr(0x09); break;
+                case XOR:  e.alu_rr(0x31); break;
+                case SLT:  e.alu_rr(0x39); e.setcc(CC_L); break;
+                case SLTU: e.alu_rr(0x39); e.setcc(CC_B); break;
+                case SLL:  e.shift_cl(4); break;   // x86 masks the count to 5 bits, as RV32I does
+                case SRL:  e.shift_cl(5); break;
+                case SRA:  e.shift_cl(7); break;
+            }
+            e.store_guest(i.rd);
+            return true;
+
+        // Division and MULHSU have no single x86 instruction, the interpreter runs them
+        case MUL: case MULH: case MULHU:
+            e.load_guest(EAX, i.rs1);
+            e.load_guest(ECX, i.rs2);
+            switch (i.op) {
+                case MUL:   e.bytes({0x0F, 0xAF, 0xC1}); break;                 // imul eax, ecx
+                case MULH:  e.bytes({0xF7, 0xE9, 0x89, 0xD0}); break;           // imul ecx; mov eax, edx
+                case MULHU: e.bytes({0xF7, 0xE1, 0x89, 0xD0}); break;           // mul ecx; mov eax, edx
+            }
+            e.store_guest(i.rd);
+            return true;
+
+        // Zba/Zbb ops with a baseline x86-64 equivalent; CLZ/CTZ/CPOP/ORC.B would
+        // need LZCNT/TZCNT/POPCNT and stay in the interpreter
+        case SH1ADD: case SH2ADD: case SH3ADD: case ANDN: case ORN: case XNOR:
+        case MIN: case MINU: case MAX: case MAXU: case ROL: case ROR:
+            e.load_guest(EAX, i.rs1);
+            e.load_guest(ECX, i.rs2);
+            switch (i.op) {
+                case SH1ADD: e.bytes({0x8D, 0x04, 0x41}); break;                // lea eax, [rcx + rax*2]
+                case SH2ADD: e.bytes({0x8D, 0x04, 0x81}); break;                // lea eax, [rcx + rax*4]
+                case SH3ADD: e.bytes({0x8D, 0x04, 0xC1}); break;                // lea eax, [rcx + rax*8]
+                case ANDN:   e.bytes({0xF7, 0xD1}); e.alu_rr(0x21); break;      // not ecx; and
+                case ORN:    e.bytes({0xF7, 0xD1}); e.alu_rr(0x09); break;      // not ecx; or
+                case XNOR:   e.alu_rr(0x31); e.bytes({0xF7, 0xD0}); break;      // xor; not eax
+                case MIN:    e.alu_rr(0x39); e.bytes({0x0F, 0x4F, 0xC1}); break; // cmp; cmovg eax, ecx
+                case MINU:   e.alu_rr(0x39); e.bytes({0x0F, 0x47, 0xC1}); break; // cmp; cmova eax, ecx
+                case MAX:    e.alu_rr(0x39); e.bytes({0x0F, 0x4C, 0xC1}); break; // cmp; cmovl eax, ecx
+                case MAXU:   e.alu_rr(0x39); e.bytes({0x0F, 0x42, 0xC1}); break; // cmp; cmovb eax, ecx
+                case ROL:    e.shift_cl(0); break;
+                case ROR:    e.shift_cl(1); break;
+            }
+            e.store_guest(i.rd);
+            return true;
+
+        case ZEXT_H: case SEXT_B: case SEXT_H: case REV8: case RORI:
+            e.load_guest(EAX, i.rs1);
+            switch (i.op) {
+                case ZEXT_H: e.bytes({0x0F, 0xB7, 0xC0}); break;                // movzx eax, ax
+                case SEXT_B: e.bytes({0x0F, 0xBE, 0xC0}); break;                // movsx eax, al
+                case SEXT_H: e.bytes({0x0F, 0xBF, 0xC0}); break;                // movsx eax, ax
+                case REV8:   e.bytes({0x0F, 0xC8}); break;                      // bswap eax
+                case RORI:   e.shift_imm(1, i.imm & 0x1F); break;
+            }
+            e.store_guest(i.rd);
+            return true;
+
+        case LB: case LH: case LW: case LBU: case LHU: {
+            e.load_guest(EAX, i.rs1);
+            e.alu_ri(0x05, i.imm);
+            e.bytes({0x89, 0xC6});                                 // mov esi, eax
+            e.mark_site(index);
+            const void* fn = i.op == LB ? (const void*)jit_lb : i.op == LH ? (const void*)jit_lh :
+                             i.op == LW ? (const void*)jit_lw : i.op == LBU ? (const void*)jit_lbu :
+                             (const void*)jit_lhu;
+            e.call_mem(fn);
+            e.store_guest(i.rd);
+            return true;
+        }
+        case SB: case SH: case SW: {
+            e.load_guest(EAX, i.rs1);
+            e.alu_ri(0x05, i.imm);
+            e.bytes({0x89, 0xC6});                                 // mov esi, eax
+            e.load_guest(EDX, i.rs2);
+            e.mark_site(index);
+            const void* fn = i.op == SB ? (const void*)jit_sb : i.op == SH ? (const void*)jit_sh :
+                             (const void*)jit_sw;
+            e.call_mem(fn);
+            return true;
+        }
+
+        case FENCE: case FENCE_TSO: case PAUSE:
+            return true;
+
+        case BEQ: case BNE: case BLT: case BGE: case BLTU: case BGEU: {
+            uint8_t cc = i.op == BEQ ? CC_E : i.op == BNE ? CC_NE : i.op == BLT ? CC_L :
+                         i.op == BGE ? CC_GE : i.op == BLTU ? CC_B : CC_AE;
+            e.load_guest(EAX, i.rs1);
+            e.load_guest(ECX, i.rs2);
+            e.alu_rr(0x39);                                        // cmp eax, ecx
+            e.mov_imm(EAX, next_pc);                               // mov keeps the flags
+            e.mov_imm(EDX, pc + i.imm);
+            e.cmov_edx(cc);
+            ended = true;
+            return true;
+        }
+        case JAL:
+            e.mov_imm(EAX, next_pc);
+            e.store_guest(i.rd);
+            e.mov_imm(EAX, pc + i.imm);
+            ended = true;
+            return true;
+        case JALR:
+            e.load_guest(EAX, i.rs1);
+            e.alu_ri(0x05, i.imm);
+            e.alu_ri(0x25, ~1u);
+            e.bytes({0x89, 0xC2});                                 // mov edx, eax (target)
+            e.mov_imm(EAX, next_pc);
+            e.store_guest(i.rd);
+            e.bytes({0x89, 0xD0});                                 // mov eax, edx
+            ended = true;
+            return true;
+
+        default:   // RET, ECALL/EBREAK, MULHSU, division, CLZ/CTZ/CPOP/ORC.B and the stop word stay in the interpreter
+            return false;
+    }
+}
+
+native_block_fn jit_x86_64::compile(const DecodedInst* insts, const uint32_t* offsets, size_t count,
+                                    uint32_t code_base, size_t first, size_t& translated) {
+    translated = 0;
+    if (first + count > INT32_MAX) {
+        return nullptr;     // fault sites are stored as 32-bit immediates
+    }
+    emitter e;
+    e.prologue();
+
+    bool ended = false;
+    while (translated < count && !ended) {
+        if (!translate(e, insts[translated], first + translated, code_base + offsets[translated],
+                       code_base + offsets[translated + 1], ended)) {
+            break;
+        }
+        translated++;
+    }
+    if (translated == 0) {
+        return nullptr;
+    }
+    if (!ended) {
+        // Hand back to the interpreter at the first instruction not translated
+        e.mov_imm(EAX, code_base + offsets[translated]);
+    }
+    e.epilogue();
+
+    // Copy into its own pages and flip them to executable (never writable and executable)
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (e.code.size() + page - 1) / page * page;
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        translated = 0;
+        return nullptr;
+    }
+    std::memcpy(mem, e.code.data(), e.code.size());
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, size);
+        translated = 0;
+        return nullptr;
+    }
+    regions.push_back({mem, size});
+    return reinterpret_cast<native_block_fn>(mem);
+}
+
+jit_x86_64::~jit_x86_64() {
+    for (const region& r : regions) {
+        munmap(r.addr, r.size);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef JIT_X86_64_H
+#define JIT_X86_64_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dis_rv32i.h"
+
+class mem_rv32i;
+
+// Native code for (a prefix of) one basic block. Runs against the guest register
+// file and memory and returns the guest pc execution continues at. Before each load
+// or store it sets *site to that instruction's index, so a fault reports it.
+typedef uint32_t (*native_block_fn)(uint32_t* regs, mem_rv32i* mem, size_t* site);
+
+// x86-64 translator for hot basic blocks. Guest registers stay in the CPU's register
+// array (addressed through rbx), loads and stores call back into mem_rv32i.
+// Owns the executable memory of everything it translated.
+class jit_x86_64 {
+public:
+    jit_x86_64() = default;
+    jit_x86_64(const jit_x86_64&) = delete;
+    jit_x86_64& operator=(const jit_x86_64&) = delete;
+    ~jit_x86_64();
+
+    // Translates the longest supported prefix of count instructions, instruction k
+    // being at guest address code_base + offsets[k] (offsets has count + 1 entries,
+    // the last one where the block falls through to) and at index first + k of the
+    // program. Sets translated to the number of instructions covered; returns nullptr
+    // if not even the first is supported.
+    native_block_fn compile(const DecodedInst* insts, const uint32_t* offsets, size_t count,
+                            uint32_t code_base, size_t first, size_t& translated);
+
+private:
+    struct region {
+        void* addr;
+        size_t size;
+    };
+    std::vector<region> regions;
+};
+
+#endif //JIT_X86_64_H
@@ -0,0 +1,454 @@
+#include "lanes_rv32i.h"
+#include "host_rv32i.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RV32I_LANES_X86
+#endif
+
+static bool have_avx2() {
+#ifdef RV32I_LANES_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// Exit reason of a JAL or branch whose predecoded target is a TARGET_TRAP
+static EXIT_REASON static_trap(uint32_t target) {
+    switch (target) {
+        case TARGET_UNDERFLOW: return EXIT_PC_UNDERFLOW;
+        case TARGET_MISALIGNED: return EXIT_PC_MISALIGNED;
+        default: return EXIT_PC_OVERFLOW;
+    }
+}
+
+// Lanes of a mask in ascending order: for (uint32_t m = mask; m; m &= m - 1) { size_t l = LANE(m); ... }
+#define LANE(m) static_cast<size_t>(__builtin_ctz(m))
+
+lanes_rv32i::lanes_rv32i() {
+    for (std::unique_ptr<cpu_rv32i>& cpu : cpus) {
+        cpu = std::make_unique<cpu_rv32i>();
+    }
+    std::memset(x, 0, sizeof(x));
+    std::fill(std::begin(index), std::end(index), UINT32_MAX);
+#ifdef RV32I_LANES_X86
+    run_group_fn = have_avx2() ? run_group_avx2 : run_group_generic;
+#else
+    run_group_fn = run_group_generic;
+#endif
+}
+
+const char* lanes_rv32i::isa() {
+#if defined(__x86_64__)
+    return have_avx2() ? "AVX2" : "SSE2";
+#else
+    return have_avx2() ? "AVX2" : "scalar";
+#endif
+}
+
+void lanes_rv32i::finish(size_t lane, EXIT_REASON reason, uint32_t pc, uint32_t addr) {
+    exits_[lane] = {reason, pc, addr};
+    a0[lane] = x[10][lane];
+    active &= ~(1u << lane);
+}
+
+void lanes_rv32i::fall_back(const prog_rv32i& prog, size_t lane) {
+    cpu_rv32i& cpu = *cpus[lane];
+    for (size_t r = 0; r < 32; r++) {
+        cpu.registers[r] = x[r][lane];
+    }
+    cpu.pc = prog.pc_of(index[lane], code_base);
+    exits_[lane] = cpu.execute(prog);
+    a0[lane] = cpu.read_reg(10);
+    active &= ~(1u << lane);
+    counters.fallbacks++;
+}
+
+// The group's lanes share one instruction index, `at`, while they run; index[] is
+// only brought up to date when the group stops or before an access that may fault.
+// Register rows are computed for all LANES and blended into the group's lanes, so
+// every operation is a fixed-length loop the compiler vectorises.
+__attribute__((always_inline))
+inline void lanes_rv32i::run_group(const prog_rv32i& prog, uint32_t mask) {
+    const DecodedInst* code = prog.decoded.data();
+    const uint32_t* targets = prog.targets.data();
+    const size_t stop = prog.decoded.size() - 1;
+
+    alignas(32) uint32_t on[LANES];     // all ones in the group's lanes
+    alignas(32) uint32_t v[LANES] = {}; // result row of the current instruction
+    for (size_t l = 0; l < LANES; l++) {
+        on[l] = (mask >> l) & 1 ? ~0u : 0;
+    }
+    const uint32_t lanes_on = __builtin_popcount(mask);
+
+    // A group apart from the others runs until it reaches the first waiting lane
+    uint32_t limit = UINT32_MAX;
+    for (uint32_t m = active & ~mask; m; m &= m - 1) {
+        limit = std::min(limit, index[LANE(m)]);
+    }
+
+    uint32_t at = index[LANE(mask)];
+    auto set_index = [&](uint32_t lanes, uint32_t to) {
+        for (uint32_t m = lanes; m; m &= m - 1) {
+            index[LANE(m)] = to;
+        }
+    };
+    auto keep = [&](uint8_t rd) {
+        if (rd == 0) return;
+        uint32_t* d = x[rd];
+        for (size_t l = 0; l < LANES; l++) {
+            d[l] = (v[l] & on[l]) | (d[l] & ~on[l]);
+        }
+    };
+    auto stop_all = [&](EXIT_REASON reason, uint32_t pc, uint32_t addr) {
+        for (uint32_t m = mask; m; m &= m - 1) {
+            finish(LANE(m), reason, pc, addr);
+        }
+    };
+
+#ifdef RV32I_RESERVED_MEMORY
+    // A fault longjmps back to run() with the faulting lane still at `at`
+    #define SITE_SYNC   set_index(mask, at)
+    #define SITE(l)     { fault_lane = (l); scope->watch(cpus[l]->memory); \
+                          std::atomic_signal_fence(std::memory_order_seq_cst); }
+#else
+    #define SITE_SYNC
+    #define SITE(l)
+#endif
+
+    #define ROWS(expr)  { for (size_t l = 0; l < LANES; l++) { v[l] = (expr); } keep(i.rd); break; }
+    #define LOAD(read, type) { SITE_SYNC; \
+                          for (uint32_t m = mask; m; m &= m - 1) { size_t l = LANE(m); SITE(l); \
+                              v[l] = (uint32_t)(type)cpus[l]->memory.read(a[l] + imm); } \
+                          keep(i.rd); break; }
+    #define STORE(write, type) { SITE_SYNC; \
+                          for (uint32_t m = mask; m; m &= m - 1) { size_t l = LANE(m); SITE(l); \
+                              cpus[l]->memory.write(a[l] + imm, (type)b[l]); } \
+                          break; }
+    #define BRANCH(cond) { uint32_t taken = 0; \
+                          for (size_t l = 0; l < LANES; l++) { taken |= (uint32_t)(cond) << l; } \
+                          if (!branch(taken & mask)) return; \
+                          break; }
+
+    for (;;) {
+        const DecodedInst& i = code[at];
+        const uint32_t* a = x[i.rs1];
+        const uint32_t* b = x[i.rs2];
+        const uint32_t imm = static_cast<uint32_t>(i.imm);
+        const uint32_t pc = prog.pc_of(at, code_base);
+        uint32_t next = at + 1;
+        counters.steps++;
+        counters.lane_steps += lanes_on;
+
+        // Conditional branch taken by the lanes in `taken`; false if the group stops
+        auto branch = [&](uint32_t taken) -> bool {
+            if (!taken) return true;
+            uint32_t target = targets[at];
+            if (target >= TARGET_UNDERFLOW) {
+                for (uint32_t m = taken; m; m &= m - 1) {
+                    finish(LANE(m), static_trap(target), pc, pc + imm);
+                }
+                set_index(mask & ~taken, at + 1);
+                return false;
+            }
+            if (taken == mask) {
+                next = target;
+                return true;
+            }
+            set_index(taken, target);
+            set_index(mask & ~taken, at + 1);
+            return false;
+        };
+        // Indirect jump of each lane to t[lane]; false if the group stops
+        auto jump = [&](const uint32_t* t) -> bool {
+            uint32_t first = t[LANE(mask)];
+            bool together = true;
+            for (uint32_t m = mask; m; m &= m - 1) {
+                together &= t[LANE(m)] == first;
+            }
+            for (uint32_t m = mask; m; m &= m - 1) {
+                size_t l = LANE(m);
+                size_t to;
+                EXIT_REASON trap;
+                if (t[l] == cpu_rv32i::RETURN_SENTINEL) {
+                    finish(l, EXIT_RETURN, pc, 0);
+                } else if (!checked_index(prog, t[l], code_base, to, trap)) {
+                    finish(l, trap, pc, t[l]);
+                } else if (together) {
+                    next = static_cast<uint32_t>(to);
+                    return true;
+                } else {
+                    index[l] = static_cast<uint32_t>(to);
+                }
+            }
+            return false;
+        };
+
+        switch (i.op) {
+            case LUI: ROWS(imm)
+            case AUIPC: ROWS(pc + imm)
+
+            case JAL: {
+                uint32_t link = prog.pc_of(at + 1, code_base);
+                uint32_t target = targets[at];
+                for (size_t l = 0; l < LANES; l++) {
+                    v[l] = link;
+                }
+                keep(i.rd);
+                if (target >= TARGET_UNDERFLOW) {
+                    stop_all(static_trap(target), pc, pc + imm);
+                    return;
+                }
+                next = target;
+                break;
+            }
+            case JALR:
+            case RET: {
+                const uint32_t* base = i.op == RET ? x[1] : a;
+                const uint32_t offset = i.op == RET ? 0 : imm;
+                alignas(32) uint32_t t[LANES];
+                for (size_t l = 0; l < LANES; l++) {
+                    t[l] = (base[l] + offset) & ~1u;
+                }
+                uint32_t link = prog.pc_of(at + 1, code_base);
+                for (size_t l = 0; l < LANES; l++) {
+                    v[l] = link;
+                }
+                keep(i.rd);
+                if (!jump(t)) return;
+                break;
+            }
+
+            case BEQ: BRANCH(a[l] == b[l])
+            case BNE: BRANCH(a[l] != b[l])
+            case BLT: BRANCH((int32_t)a[l] < (int32_t)b[l])
+            case BGE: BRANCH((int32_t)a[l] >= (int32_t)b[l])
+            case BLTU: BRANCH(a[l] < b[l])
+            case BGEU: BRANCH(a[l] >= b[l])
+
+            case LB: LOAD(read8, int8_t)
+            case LH: LOAD(read16, int16_t)
+            case LW: LOAD(read32, uint32_t)
+            case LBU: LOAD(read8, uint8_t)
+            case LHU: LOAD(read16, uint16_t)
+            case SB: STORE(write8, uint8_t)
+            case SH: STORE(write16, uint16_t)
+            case SW: STORE(write32, uint32_t)
+
+            case ADDI: ROWS(a[l] + imm)
+            case SLTI: ROWS((int32_t)a[l] < (int32_t)imm ? 1u : 0u)
+            case SLTIU: ROWS(a[l] < imm ? 1u : 0u)
+            case XORI: ROWS(a[l] ^ imm)
+            case ORI: ROWS(a[l] | imm)
+            case ANDI: ROWS(a[l] & imm)
+            case SLLI: ROWS(a[l] << (imm & 0x1F))
+            case SRLI: ROWS(a[l] >> (imm & 0x1F))
+            case SRAI: ROWS((uint32_t)((int32_t)a[l] >> (imm & 0x1F)))
+
+            case ADD: ROWS(a[l] + b[l])
+            case SUB: ROWS(a[l] - b[l])
+            case SLL: ROWS(a[l] << (b[l] & 0x1F))
+            case SLT: ROWS((int32_t)a[l] < (int32_t)b[l] ? 1u : 0u)
+            case SLTU: ROWS(a[l] < b[l] ? 1u : 0u)
+            case XOR: ROWS(a[l] ^ b[l])
+            case SRL: ROWS(a[l] >> (b[l] & 0x1F))
+            case SRA: ROWS((uint32_t)((int32_t)a[l] >> (b[l] & 0x1F)))
+            case OR: ROWS(a[l] | b[l])
+            case AND: ROWS(a[l] & b[l])
+
+            case MUL: ROWS(a[l] * b[l])
+            case MULH: ROWS((uint32_t)((uint64_t)((int64_t)(int32_t)a[l] * (int32_t)b[l]) >> 32))
+            case MULHSU: ROWS((uint32_t)((uint64_t)((int64_t)(int32_t)a[l] * (int64_t)b[l]) >> 32))
+            case MULHU: ROWS((uint32_t)(((uint64_t)a[l] * b[l]) >> 32))
+            // Same results as the scalar interpreter for x/0 and INT32_MIN / -1
+            case DIV: ROWS(b[l] == 0 ? UINT32_MAX
+                           : ((int32_t)a[l] == INT32_MIN && (int32_t)b[l] == -1) ? (uint32_t)INT32_MIN
+                           : (uint32_t)((int32_t)a[l] / (int32_t)b[l]))
+            case DIVU: ROWS(b[l] == 0 ? UINT32_MAX : a[l] / b[l])
+            case REM: ROWS(b[l] == 0 ? a[l]
+                           : ((int32_t)a[l] == INT32_MIN && (int32_t)b[l] == -1) ? 0u
+                           : (uint32_t)((int32_t)a[l] % (int32_t)b[l]))
+            case REMU: ROWS(b[l] == 0 ? a[l] : a[l] % b[l])
+
+            case SH1ADD: ROWS((a[l] << 1) + b[l])
+            case SH2ADD: ROWS((a[l] << 2) + b[l])
+            case SH3ADD: ROWS((a[l] << 3) + b[l])
+
+            case ANDN: ROWS(a[l] & ~b[l])
+            case ORN: ROWS(a[l] | ~b[l])
+            case XNOR: ROWS(~(a[l] ^ b[l]))
+            case MIN: ROWS((uint32_t)std::min((int32_t)a[l], (int32_t)b[l]))
+            case MINU: ROWS(std::min(a[l], b[l]))
+            case MAX: ROWS((uint32_t)std::max((int32_t)a[l], (int32_t)b[l]))
+            case MAXU: ROWS(std::max(a[l], b[l]))
+            case ROL: ROWS(rotl32(a[l], b[l]))
+            case ROR: ROWS(rotr32(a[l], b[l]))
+            case ZEXT_H: ROWS(a[l] & 0xFFFF)
+            case CLZ: ROWS(a[l] ? (uint32_t)__builtin_clz(a[l]) : 32u)
+            case CTZ: ROWS(a[l] ? (uint32_t)__builtin_ctz(a[l]) : 32u)
+            case CPOP: ROWS((uint32_t)__builtin_popcount(a[l]))
+            case SEXT_B: ROWS((uint32_t)(int32_t)(int8_t)a[l])
+            case SEXT_H: ROWS((uint32_t)(int32_t)(int16_t)a[l])
+            case RORI: ROWS(rotr32(a[l], imm & 0x1F))
+            case ORC_B: ROWS(orc_b(a[l]))
+            case REV8: ROWS(__builtin_bswap32(a[l]))
+
+            case FENCE:
+            case FENCE_TSO:
+            case PAUSE:
+                break;
+
+            // Host calls run a lane at a time on the lane's CPU. A lane moves past the
+            // ECALL as soon as its call is done, so none runs twice if another faults.
+            case ECALL: {
+                SITE_SYNC;
+                uint32_t stopped = 0;
+                for (uint32_t m = mask; m; m &= m - 1) {
+                    size_t l = LANE(m);
+                    cpu_rv32i& cpu = *cpus[l];
+                    uint32_t number = x[17][l];
+                    for (size_t r = 10; r <= 17; r++) {
+                        cpu.registers[r] = x[r][l];
+                    }
+                    SITE(l);
+                    if (number >= HOST_CALL_COUNT || !prog.host_calls[number] || !run_host_call(cpu, number)) {
+                        finish(l, EXIT_ECALL, pc, number);
+                        stopped |= 1u << l;
+                    } else {
+                        x[10][l] = cpu.registers[10];
+                        index[l] = at + 1;
+                    }
+                }
+                if (stopped) {
+                    return;
+                }
+                break;
+            }
+            case EBREAK:
+                stop_all(EXIT_EBREAK, pc, 0);
+                return;
+
+            // Either the stop word past the end, or a word that didn't decode
+            case INVALID:
+            default:
+                if (at == stop) {
+                    stop_all(EXIT_PC_OVERFLOW, pc, pc);
+                } else {
+                    stop_all(EXIT_ILLEGAL_INSTRUCTION, pc, 0);
+                }
+                return;
+        }
+
+        at = next;
+        if (at >= limit) {
+            set_index(mask, at);
+            return;
+        }
+    }
+
+    #undef ROWS
+    #undef LOAD
+    #undef STORE
+    #undef BRANCH
+    #undef SITE_SYNC
+    #undef SITE
+}
+
+void lanes_rv32i::run_group_generic(lanes_rv32i& lanes, const prog_rv32i& prog, uint32_t mask) {
+    lanes.run_group(prog, mask);
+}
+
+#ifdef RV32I_LANES_X86
+// The same code compiled for AVX2, one 256-bit operation per register row
+__attribute__((target("avx2")))
+void lanes_rv32i::run_group_avx2(lanes_rv32i& lanes, const prog_rv32i& prog, uint32_t mask) {
+    lanes.run_group(prog, mask);
+}
+#endif
+
+size_t lanes_rv32i::run(const prog_rv32i& prog, const uint32_t* args, size_t stride, size_t count,
+                        uint32_t* results, exec_result* exits) {
+    count = std::min(count, LANES);
+    size_t argc = std::min<size_t>(stride, 8);
+    code_base = cpus[0]->memory.get_code_base();
+
+    std::memset(x, 0, sizeof(x));
+    std::fill(std::begin(index), std::end(index), UINT32_MAX);
+    for (size_t l = 0; l < count; l++) {
+        cpu_rv32i& cpu = *cpus[l];
+        if (used[l]) {
+            cpu.reset();
+        }
+        used[l] = true;
+        cpu.load_program(prog.code);
+        x[1][l] = cpu.registers[1];     // RETURN_SENTINEL
+        x[2][l] = cpu.registers[2];     // sp
+        for (size_t k = 0; k < argc; k++) {
+            x[10 + k][l] = args[l * stride + k];
+        }
+        exits_[l] = exec_result();
+        index[l] = 0;
+    }
+    active = (1u << count) - 1;
+    apart = 0;
+
+#ifdef RV32I_RESERVED_MEMORY
+    // Only members change between here and a fault, so the loop below can pick up
+    // where it was with the faulting lane stopped
+    mem_rv32i::fault_scope guard(cpus[0]->memory);
+    scope = &guard;
+    if (sigsetjmp(guard.env, 0)) {
+        size_t l = fault_lane;
+        finish(l, EXIT_MEMORY_FAULT, prog.pc_of(index[l], code_base), guard.fault_addr);
+    }
+#endif
+
+    while (active) {
+        if ((active & (active - 1)) == 0) {
+            fall_back(prog, LANE(active));  // the last lane runs faster on its own
+            continue;
+        }
+        // Lanes furthest behind go first
+        uint32_t lead = UINT32_MAX;
+        for (uint32_t m = active; m; m &= m - 1) {
+            lead = std::min(lead, index[LANE(m)]);
+        }
+        uint32_t mask = 0;
+        for (uint32_t m = active; m; m &= m - 1) {
+            if (index[LANE(m)] == lead) {
+                mask |= 1u << LANE(m);
+            }
+        }
+        if (mask == active) {
+            apart = 0;
+        } else if (++apart > DIVERGENCE_LIMIT) {
+            // Not coming back together: the lanes ahead finish on their own
+            for (uint32_t m = active & ~mask; m; m &= m - 1) {
+                fall_back(prog, LANE(m));
+            }
+            apart = 0;
+            continue;
+        }
+        run_group_fn(*this, prog, mask);
+    }
+
+#ifdef RV32I_RESERVED_MEMORY
+    scope = nullptr;
+#endif
+
+    size_t faults = 0;
+    for (size_t l = 0; l < count; l++) {
+        bool returned = exits_[l].reason == EXIT_RETURN;
+        results[l] = returned ? a0[l] : 0;
+        faults += returned ? 0 : 1;
+        if (exits) {
+            exits[l] = exits_[l];
+        }
+    }
+    return faults;
+}
@@ -0,0 +1,79 @@
+#ifndef LANES_RV32I_H
+#define LANES_RV32I_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "cpu_rv32i.h"
+
+// Lockstep (SIMT) execution: one program run for up to LANES argument sets at once,
+// like the threads of a GPU warp. Registers are kept structure-of-arrays, a row of
+// LANES values per register, so each instruction is decoded once and applied to all
+// lanes with whole-row operations that compile to vector instructions (AVX2 when the
+// host has it, SSE2 otherwise).
+//
+// Lanes whose pcs differ after a branch are masked off while the lanes furthest
+// behind in the program run, which brings if/else arms and early loop exits back
+// together. Lanes still apart after DIVERGENCE_LIMIT such switches, and a lane left
+// on its own, are finished by the scalar interpreter. Each lane has its own
+// cpu_rv32i, for its guest memory and that fallback.
+class lanes_rv32i {
+public:
+    static constexpr size_t LANES = 8;
+    static constexpr uint32_t DIVERGENCE_LIMIT = 32;
+
+    // Accumulated over run() calls
+    struct stats {
+        uint64_t steps = 0;         // instructions issued in lockstep
+        uint64_t lane_steps = 0;    // lane-instructions they covered, up to LANES per step
+        uint64_t fallbacks = 0;     // lanes finished by the scalar interpreter
+    };
+
+    lanes_rv32i();
+
+    // Runs count <= LANES invocations of prog, lane l with the first min(stride, 8)
+    // words at args + l * stride in a0-a7. results[l] receives a0, or 0 if the lane
+    // faulted, and exits[l] (if given) how it stopped. Returns how many lanes faulted.
+    size_t run(const prog_rv32i& prog, const uint32_t* args, size_t stride, size_t count,
+               uint32_t* results, exec_result* exits = nullptr);
+
+    const stats& get_stats() const { return counters; }
+
+    // Vector instruction set the lockstep steps use, e.g. "AVX2"
+    static const char* isa();
+
+private:
+    using group_fn = void (*)(lanes_rv32i& lanes, const prog_rv32i& prog, uint32_t mask);
+
+    std::unique_ptr<cpu_rv32i> cpus[LANES];
+    bool used[LANES] = {};              // cpus[l] needs a reset before its next run
+
+    alignas(32) uint32_t x[32][LANES];  // x[reg][lane]
+    alignas(32) uint32_t index[LANES];  // instruction each lane is at
+    exec_result exits_[LANES];
+    uint32_t a0[LANES];                 // value returned by each finished lane
+    uint32_t active = 0;                // lanes still running in lockstep, one bit each
+    uint32_t apart = 0;                 // group switches since all lanes were together
+    uint32_t code_base = 0;
+    stats counters;
+    group_fn run_group_fn;
+
+#ifdef RV32I_RESERVED_MEMORY
+    // Lane whose memory the current access goes to, for reporting a fault
+    mem_rv32i::fault_scope* scope = nullptr;
+    size_t fault_lane = 0;
+#endif
+
+    // Runs the lanes in mask, all at one instruction, until they split up, reach a
+    // waiting lane or stop; built once per vector instruction set
+    void run_group(const prog_rv32i& prog, uint32_t mask);
+    static void run_group_generic(lanes_rv32i& lanes, const prog_rv32i& prog, uint32_t mask);
+    static void run_group_avx2(lanes_rv32i& lanes, const prog_rv32i& prog, uint32_t mask);
+
+    void finish(size_t lane, EXIT_REASON reason, uint32_t pc, uint32_t addr);
+    // Runs lane to completion on its own CPU
+    void fall_back(const prog_rv32i& prog, size_t lane);
+};
+
+#endif //LANES_RV32I_H
@@ -4,76 +4,482 @@
 
 #include "mem_rv32i.h"
 
-// Static member variable initialization
-uint32_t mem_rv32i::INITIAL_SIZE = 0;
-uint32_t mem_rv32i::CODE_START = 0;
-uint32_t mem_rv32i::DATA_START = 0;
-uint32_t mem_rv32i::HEAP_START = 0;
-uint32_t mem_rv32i::STACK_START = 0;
-
-// Initialize static memory layout values
-void mem_rv32i::init() {
-    INITIAL_SIZE = 2 * 1024 * 1024;      // Start with 2MB
-    CODE_START = 0x00010000;             // Code at 64KB
-    DATA_START = 0x00100000;             // Data at 1MB
-    HEAP_START = 0x01000000;             // Heap at 16MB
-    STACK_START = 0x7fff0000;            // Stack at ~2GB, grows down
-}
-
-mem_rv32i::mem_rv32i()
-    : memory(INITIAL_SIZE, 0)
-    , code_base(CODE_START)
+#include <stdexcept>
+
+#ifdef RV32I_RESERVED_MEMORY
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#endif
+
+#ifdef RV32I_RESERVED_MEMORY
+
+// 4 GiB plus a guard page, so a word access at 0xFFFFFFFD faults instead of
+// running off the end of the reservation
+static constexpr uint64_t RESERVATION = (1ull << 32) + mem_rv32i::PAGE_SIZE;
+
+static thread_local mem_rv32i::fault_scope* active_scope = nullptr;
+static struct sigaction previous_action;
+static std::once_flag handler_installed;
+
+static void on_fault(int sig, siginfo_t* info, void* context) {
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    for (mem_rv32i::fault_scope* scope = active_scope; scope; scope = scope->outer) {
+        uintptr_t base = (uintptr_t)scope->base;
+        if (addr >= base && addr - base < RESERVATION) {
+            if (scope->mem->grow(addr - base)) {
+                return;     // first touch of a data, heap or stack page: retry
+            }
+            scope->fault_addr = (uint32_t)(addr - base);
+            siglongjmp(scope->env, 1);
+        }
+    }
+
+    // Not a guest access: hand it to whoever was installed before us
+    if (previous_action.sa_flags & SA_SIGINFO) {
+        previous_action.sa_sigaction(sig, info, context);
+    } else if (previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN) {
+        previous_action.sa_handler(sig);
+    } else {
+        signal(sig, SIG_DFL);   // returning re-runs the access and takes the default action
+    }
+}
+
+static void install_fault_handler() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_fault;
+    // SA_NODEFER keeps SIGSEGV unblocked after the siglongjmp, so sigsetjmp
+    // doesn't have to save the signal mask on every call
+    action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previous_action);
+}
+
+mem_rv32i::fault_scope::fault_scope(mem_rv32i& mem)
+    : base(mem.base)
+    , mem(&mem)
+    , outer(active_scope) {
+    active_scope = this;
+}
+
+mem_rv32i::fault_scope::~fault_scope() {
+    active_scope = outer;
+}
+
+mem_rv32i::mem_rv32i(const mem_layout& layout)
+    : layout(layout)
+    , code_base(layout.code_start)
     , code_size(0)
-    , stack_ptr(STACK_START)
-    , heap_ptr(HEAP_START) {}
+    , stack_ptr(layout.stack_start)
+    , heap_ptr(layout.heap_start)
+    , map_next(layout.map_start)
+    , base(nullptr)
+    , committed(0)
+    , code_committed(0)
+    , map_committed(0) {
+    void* p = mmap(nullptr, RESERVATION, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Failed to reserve guest address space");
+    }
+    base = static_cast<uint8_t*>(p);
+    std::call_once(handler_installed, install_fault_handler);
+
+    uint64_t stack_top = layout.stack_start;
+    windows[0] = {layout.data_start, layout.heap_start, layout.data_start, layout.data_start, false};
+    windows[1] = {layout.heap_start, layout.heap_start + (uint64_t)HEAP_SIZE, layout.heap_start, layout.heap_start, false};
+    windows[2] = {stack_top - STACK_SIZE, stack_top, stack_top - STACK_INITIAL, stack_top, true};
+    try {
+        commit(layout.stack_start - STACK_INITIAL, STACK_INITIAL);
+    } catch (...) {
+        munmap(base, RESERVATION);
+        throw;
+    }
+}
+
+mem_rv32i::~mem_rv32i() {
+    munmap(base, RESERVATION);
+}
+
+void mem_rv32i::commit(uint32_t addr, uint64_t size) {
+    uint64_t start = addr & ~(uint64_t)PAGE_MASK;
+    uint64_t end = (addr + size + PAGE_MASK) & ~(uint64_t)PAGE_MASK;
+    if (end > (1ull << 32)) {
+        // Wraps around the top of the address space
+        commit(0, end - (1ull << 32));
+        end = 1ull << 32;
+    }
+    if (end <= start) {
+        return;
+    }
+    if (mprotect(base + start, end - start, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error("Failed to commit guest memory");
+    }
+    committed += end - start;
+}
 
-void mem_rv32i::ensure_capacity(uint32_t addr) {
-    if (addr >= memory.size()) {
-        // Grow memory as needed
-        size_t new_size = std::max(static_cast<size_t>(addr) + 1, static_cast<size_t>(memory.size() * 2));
-        memory.resize(new_size, 0);
+bool mem_rv32i::grow(uint64_t addr) {
+    uint64_t page = addr & ~(uint64_t)PAGE_MASK;
+    for (window& w : windows) {
+        if (addr < w.start || addr >= w.end) {
+            continue;
+        }
+        // Open the gap between the window and the page too, so the window stays one range
+        uint64_t lo = std::min(w.lo, page);
+        uint64_t hi = std::max(w.hi, page + PAGE_SIZE);
+        if (lo == w.lo && hi == w.hi) {
+            return false;   // already accessible, so the fault is something else
+        }
+        if (lo < w.lo && mprotect(base + lo, w.lo - lo, PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+        if (hi > w.hi && mprotect(base + w.hi, hi - w.hi, PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+        committed += (w.lo - lo) + (hi - w.hi);
+        w.lo = lo;
+        w.hi = hi;
+        return true;
+    }
+    return false;
+}
+
+void mem_rv32i::clear(uint64_t lo, uint64_t hi, bool down) {
+    if (hi <= lo) {
+        return;
+    }
+    uint64_t near = std::min<uint64_t>(hi - lo, CLEAR_LIMIT);
+    if (down) {
+        std::memset(base + hi - near, 0, near);
+        hi -= near;
+    } else {
+        std::memset(base + lo, 0, near);
+        lo += near;
+    }
+    if (hi > lo) {
+        madvise(base + lo, hi - lo, MADV_DONTNEED);
     }
 }
 
 void mem_rv32i::load_code(const std::vector<uint8_t>& code) {
+    uint32_t previous = code_size;
     code_size = code.size();
-    ensure_capacity(code_base + code_size);
-    std::copy(code.begin(), code.end(), memory.begin() + code_base);
+    if (code_size > code_committed) {
+        commit(code_base, code_size);
+        code_committed = code_size;
+    }
+    std::copy(code.begin(), code.end(), base + code_base);
+    if (code_size < previous) {
+        std::memset(base + code_base + code_size, 0, previous - code_size);
+    }
+}
+
+// Stores can't be tracked without checks on every access, but a region is only
+// accessible as far as the guest has touched it, so that part is all that needs
+// clearing. It is zeroed in place, keeping the pages (and the code pages, which
+// the next load_code overwrites) resident for the next call.
+void mem_rv32i::reset() {
+    unmap_buffers();
+    uint64_t code_end = (code_base + (uint64_t)code_committed + PAGE_MASK) & ~(uint64_t)PAGE_MASK;
+    clear(code_base + code_size, code_end, false);
+    for (const window& w : windows) {
+        clear(w.lo, w.hi, w.down);
+    }
+}
+
+// The reservation can't alias host memory, so buffers are copied in and out
+uint32_t mem_rv32i::map_buffer(void* host, uint32_t size, bool writable) {
+    uint32_t offset = reinterpret_cast<uintptr_t>(host) & PAGE_MASK;
+    uint64_t pages = (static_cast<uint64_t>(offset) + size + PAGE_MASK) >> PAGE_BITS;
+    if (map_next - layout.map_start + (pages << PAGE_BITS) > MAP_SIZE) {
+        throw std::length_error("Mapped buffers do not fit the guest window");
+    }
+    uint32_t addr = map_next + offset;
+    uint32_t end = map_next + static_cast<uint32_t>(pages << PAGE_BITS);
+    if (end - layout.map_start > map_committed) {
+        commit(layout.map_start + map_committed, end - layout.map_start - map_committed);
+        map_committed = end - layout.map_start;
+    }
+    std::memcpy(base + addr, host, size);
+    mappings.push_back({addr, static_cast<uint8_t*>(host), size, writable});
+    map_next = end;
+    return addr;
 }
 
-uint8_t mem_rv32i::read8(uint32_t addr) {
-    ensure_capacity(addr);
-    return memory[addr];
+void mem_rv32i::unmap_buffers() {
+    for (const mapping& m : mappings) {
+        if (m.writable) {
+            std::memcpy(m.host, base + m.addr, m.size);
+        }
+    }
+    mappings.clear();
+    clear(layout.map_start, map_next, false);
+    map_next = layout.map_start;
 }
 
-void mem_rv32i::write8(uint32_t addr, uint8_t val) {
-    ensure_capacity(addr);
-    memory[addr] = val;
+#else
+
+mem_rv32i::mem_rv32i(const mem_layout& layout)
+    : layout(layout)
+    , code_base(layout.code_start)
+    , code_size(0)
+    , stack_ptr(layout.stack_start)
+    , heap_ptr(layout.heap_start)
+    , map_next(layout.map_start)
+    , pages_allocated(0) {
+    flush_tlbs();
 }
 
-uint16_t mem_rv32i::read16(uint32_t addr) {
-    ensure_capacity(addr + 1);
-    return memory[addr] | (memory[addr+1] << 8);
+void mem_rv32i::flush_tlbs() {
+    for (tlb_entry& e : tlb) {
+        e = {~0u, nullptr};
+    }
+    for (tlb_entry& e : write_tlb) {
+        e = {~0u, nullptr};
+    }
 }
 
-void mem_rv32i::write16(uint32_t addr, uint16_t val) {
-    ensure_capacity(addr + 1);
-    memory[addr] = val & 0xFF;
-    memory[addr+1] = (val >> 8) & 0xFF;
+mem_rv32i::page& mem_rv32i::slot(uint32_t vpn) {
+    page_table& table = directory[vpn >> L2_BITS];
+    if (!table) {
+        table.reset(new page[1u << L2_BITS]());
+    }
+    return table[vpn & ((1u << L2_BITS) - 1)];
+}
+
+mem_rv32i::page& mem_rv32i::lookup(uint32_t vpn) {
+    page& p = slot(vpn);
+    if (!p.data && !p.alias) {
+        p.data.reset(new uint8_t[PAGE_SIZE]());   // zeroed on first touch
+        pages_allocated++;
+    }
+    return p;
 }
 
-uint32_t mem_rv32i::read32(uint32_t addr) {
-    ensure_capacity(addr + 3);
-    return memory[addr] |
-           (memory[addr+1] << 8) |
-           (memory[addr+2] << 16) |
-           (memory[addr+3] << 24);
+uint8_t* mem_rv32i::refill(uint32_t addr) {
+    uint32_t vpn = addr >> PAGE_BITS;
+    page& p = lookup(vpn);
+    uint8_t* host = p.alias ? p.alias : p.data.get();
+    tlb[vpn & (TLB_SIZE - 1)] = {vpn, host};
+    return host;
 }
 
-void mem_rv32i::write32(uint32_t addr, uint32_t val) {
-    ensure_capacity(addr + 3);
-    memory[addr] = val & 0xFF;
-    memory[addr+1] = (val >> 8) & 0xFF;
-    memory[addr+2] = (val >> 16) & 0xFF;
-    memory[addr+3] = (val >> 24) & 0xFF;
-}
\ No newline at end of file
+uint8_t* mem_rv32i::refill_dirty(uint32_t addr) {
+    uint32_t vpn = addr >> PAGE_BITS;
+    page& p = lookup(vpn);
+    if (p.alias && !p.alias_writable) {
+        // Copy on write: stores to a read-only buffer stay in a private page
+        if (!p.data) {
+            p.data.reset(new uint8_t[PAGE_SIZE]);
+            pages_allocated++;
+        }
+        std::memcpy(p.data.get(), p.alias, PAGE_SIZE);
+        p.alias = nullptr;
+        tlb[vpn & (TLB_SIZE - 1)] = {vpn, p.data.get()};
+    }
+    if (p.alias) {
+        // Writes go straight to the host buffer, which reset() must not clear
+        write_tlb[vpn & (TLB_SIZE - 1)] = {vpn, p.alias};
+        return p.alias;
+    }
+    if (!p.dirty) {
+        p.dirty = true;
+        dirty_pages.push_back(vpn);
+    }
+    write_tlb[vpn & (TLB_SIZE - 1)] = {vpn, p.data.get()};
+    return p.data.get();
+}
+
+// Code goes in through the read path so it doesn't count as dirty: reset() leaves
+// it in place unless the guest wrote to its pages, and load_code copies it every time
+void mem_rv32i::load_code(const std::vector<uint8_t>& code) {
+    code_size = code.size();
+    for (uint32_t i = 0; i < code_size; ) {
+        uint32_t addr = code_base + i;
+        uint32_t chunk = std::min(code_size - i, PAGE_SIZE - (addr & PAGE_MASK));
+        std::copy(code.begin() + i, code.begin() + i + chunk, host_page(addr) + (addr & PAGE_MASK));
+        i += chunk;
+    }
+}
+
+void mem_rv32i::reset() {
+    unmap_buffers();
+    for (uint32_t vpn : dirty_pages) {
+        page& p = directory[vpn >> L2_BITS][vpn & ((1u << L2_BITS) - 1)];
+        std::memset(p.data.get(), 0, PAGE_SIZE);
+        p.dirty = false;
+    }
+    dirty_pages.clear();
+    for (tlb_entry& e : write_tlb) {
+        e = {~0u, nullptr};
+    }
+}
+
+uint32_t mem_rv32i::read_split(uint32_t addr, uint32_t size) {
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        val |= (uint32_t)read8(addr + i) << (8 * i);
+    }
+    return val;
+}
+
+void mem_rv32i::write_split(uint32_t addr, uint32_t val, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        write8(addr + i, (val >> (8 * i)) & 0xFF);
+    }
+}
+
+// Pages in [first, last) are covered whole by the buffer and are aliased; the
+// bytes before first and from last on are copied
+static void whole_pages(uint32_t addr, uint32_t size, uint32_t& first, uint32_t& last) {
+    first = (addr + mem_rv32i::PAGE_MASK) & ~mem_rv32i::PAGE_MASK;
+    last = (addr + size) & ~mem_rv32i::PAGE_MASK;
+    if (last < first) {
+        last = first;
+    }
+}
+
+uint32_t mem_rv32i::map_buffer(void* host, uint32_t size, bool writable) {
+    uint8_t* bytes = static_cast<uint8_t*>(host);
+    uint32_t offset = reinterpret_cast<uintptr_t>(host) & PAGE_MASK;
+    uint64_t pages = (static_cast<uint64_t>(offset) + size + PAGE_MASK) >> PAGE_BITS;
+    if (map_next - layout.map_start + (pages << PAGE_BITS) > MAP_SIZE) {
+        throw std::length_error("Mapped buffers do not fit the guest window");
+    }
+    uint32_t addr = map_next + offset;
+
+    uint32_t first, last;
+    whole_pages(addr, size, first, last);
+    for (uint32_t page_addr = first; page_addr < last; page_addr += PAGE_SIZE) {
+        page& p = slot(page_addr >> PAGE_BITS);
+        p.alias = bytes + (page_addr - addr);
+        p.alias_writable = writable;
+    }
+    flush_tlbs();
+    if (first == last) {
+        write_block(addr, bytes, size);
+    } else {
+        write_block(addr, bytes, first - addr);
+        write_block(last, bytes + (last - addr), addr + size - last);
+    }
+
+    mappings.push_back({addr, bytes, size, writable});
+    map_next += static_cast<uint32_t>(pages << PAGE_BITS);
+    return addr;
+}
+
+void mem_rv32i::unmap_buffers() {
+    if (mappings.empty()) {
+        return;
+    }
+    for (const mapping& m : mappings) {
+        uint32_t first, last;
+        whole_pages(m.addr, m.size, first, last);
+        if (m.writable) {
+            if (first == last) {
+                read_block(m.addr, m.host, m.size);
+            } else {
+                read_block(m.addr, m.host, first - m.addr);
+                read_block(last, m.host + (last - m.addr), m.addr + m.size - last);
+            }
+        }
+        for (uint32_t page_addr = first; page_addr < last; page_addr += PAGE_SIZE) {
+            slot(page_addr >> PAGE_BITS).alias = nullptr;
+        }
+    }
+    mappings.clear();
+    map_next = layout.map_start;
+    flush_tlbs();
+}
+
+#endif
+
+void mem_rv32i::read_block(uint32_t addr, void* dst, uint32_t len) {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (len) {
+        uint32_t n;
+        const uint8_t* from = span(addr, len, n);
+        std::memcpy(out, from, n);
+        out += n;
+        addr += n;
+        len -= n;
+    }
+}
+
+void mem_rv32i::write_block(uint32_t addr, const void* src, uint32_t len) {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    while (len) {
+        uint32_t n;
+        uint8_t* to = writable_span(addr, len, n);
+        std::memcpy(to, in, n);
+        in += n;
+        addr += n;
+        len -= n;
+    }
+}
+
+void mem_rv32i::move_block(uint32_t dst, uint32_t src, uint32_t len) {
+    if (static_cast<uint32_t>(dst - src) < len && dst != src) {
+        // dst overlaps the end of src: copy backwards a page at a time through a
+        // buffer, so no source byte is overwritten before it is read
+        uint8_t buffer[PAGE_SIZE];
+        while (len) {
+            uint32_t n = std::min(len, PAGE_SIZE);
+            len -= n;
+            read_block(src + len, buffer, n);
+            write_block(dst + len, buffer, n);
+        }
+        return;
+    }
+    while (len) {
+        uint32_t from_n, to_n;
+        const uint8_t* from = span(src, len, from_n);
+        uint8_t* to = writable_span(dst, from_n, to_n);
+        std::memmove(to, from, to_n);
+        src += to_n;
+        dst += to_n;
+        len -= to_n;
+    }
+}
+
+void mem_rv32i::fill_block(uint32_t addr, uint8_t val, uint32_t len) {
+    while (len) {
+        uint32_t n;
+        uint8_t* to = writable_span(addr, len, n);
+        std::memset(to, val, n);
+        addr += n;
+        len -= n;
+    }
+}
+
+int mem_rv32i::compare_block(uint32_t a, uint32_t b, uint32_t len) {
+    while (len) {
+        uint32_t a_n, b_n;
+        const uint8_t* pa = span(a, len, a_n);
+        const uint8_t* pb = span(b, a_n, b_n);
+        int diff = std::memcmp(pa, pb, b_n);
+        if (diff) {
+            return diff < 0 ? -1 : 1;
+        }
+        a += b_n;
+        b += b_n;
+        len -= b_n;
+    }
+    return 0;
+}
+
+uint32_t mem_rv32i::string_length(uint32_t addr) {
+    uint32_t length = 0;
+    while (length != UINT32_MAX) {
+        uint32_t n;
+        const uint8_t* from = span(addr, UINT32_MAX - length, n);
+        const void* zero = std::memchr(from, 0, n);
+        if (zero) {
+            return length + static_cast<uint32_t>(static_cast<const uint8_t*>(zero) - from);
+        }
+        addr += n;
+        length += n;
+    }
+    return length;
+}
@@ -3,32 +3,195 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
 #include <algorithm>
+#include <csetjmp>
+#include <cstring>
+
+// Guest memory, in one of two backends picked at build time:
+//
+// Paged (default): the 32-bit address space is split into 4 KiB pages that are
+// allocated (zeroed) the first time they are touched, found through a two-level page
+// table with a small direct-mapped cache of recent translations in front of it.
+//
+// Reserved (RV32I_RESERVED_MEMORY): the whole 4 GiB space is reserved with one
+// PROT_NONE mapping and only the code, data, heap and stack regions are made
+// accessible, so an access is a single host load or store at base + addr. Touching
+// anything else raises SIGSEGV, which is turned into a guest fault (see fault_scope).
+// Data, heap and stack are opened up a page at a time as the guest first touches
+// them, so the accessible part of each is also all a reset has to clear.
+// Guest address-space layout. Each mem_rv32i takes its own copy at construction,
+// so instances with different layouts can coexist on different threads.
+struct mem_layout {
+    uint32_t code_start = 0x00010000;   // Code at 64KB
+    uint32_t data_start = 0x00100000;   // Data at 1MB
+    uint32_t heap_start = 0x01000000;   // Heap at 16MB
+    uint32_t stack_start = 0x7fff0000;  // Stack at ~2GB, grows down
+    uint32_t map_start = 0x40000000;    // Host buffers mapped for pointer arguments at 1GB
+};
 
 class mem_rv32i {
-private:
-    static uint32_t INITIAL_SIZE;
-    static uint32_t CODE_START;
-    static uint32_t DATA_START;
-    static uint32_t HEAP_START;
-    static uint32_t STACK_START;
+public:
+    static constexpr uint32_t PAGE_BITS = 12;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+
+#ifdef RV32I_RESERVED_MEMORY
+    // While alive, a SIGSEGV inside this thread's guest memory longjmps to env with
+    // the faulting guest address in fault_addr instead of killing the process
+    struct fault_scope {
+        sigjmp_buf env;
+        uint32_t fault_addr = 0;
+        const uint8_t* base;
+        mem_rv32i* mem;
+        fault_scope* outer;
+
+        explicit fault_scope(mem_rv32i& mem);
+        ~fault_scope();
+
+        // Catches faults in mem instead, for callers that switch between memories
+        void watch(mem_rv32i& m) { base = m.base; mem = &m; }
+    };
+#endif
 
-    std::vector<uint8_t> memory;
+    // Bytes of guest address space for mapped host buffers, from map_start
+    static constexpr uint32_t MAP_SIZE = 0x10000000;
+
+private:
+    mem_layout layout;
 
     uint32_t code_base;
     uint32_t code_size;
     uint32_t stack_ptr;
     uint32_t heap_ptr;
 
-    void ensure_capacity(uint32_t addr);
+    // A host buffer mapped into the guest by map_buffer
+    struct mapping {
+        uint32_t addr;
+        uint8_t* host;
+        uint32_t size;
+        bool writable;
+    };
+    std::vector<mapping> mappings;
+    uint32_t map_next;      // guest page where the next buffer goes
 
-public:
-    static void init();
+#ifdef RV32I_RESERVED_MEMORY
+    static constexpr uint32_t HEAP_SIZE = 16 * 1024 * 1024;
+    static constexpr uint32_t STACK_SIZE = 8 * 1024 * 1024;
+
+    // Stack bytes accessible from the start, enough for typical frames
+    static constexpr uint32_t STACK_INITIAL = 8 * 1024;
+    // Bytes of a region reset() zeroes in place; pages past them are dropped instead
+    static constexpr uint32_t CLEAR_LIMIT = 64 * 1024;
+
+    // Part of a region the guest has touched: [lo, hi) is accessible and extends
+    // page by page over [start, end) as the guest faults on the pages around it
+    struct window {
+        uint64_t start;
+        uint64_t end;
+        uint64_t lo;
+        uint64_t hi;
+        bool down;          // grows down from end, like the stack
+    };
+
+    uint8_t* base;          // host address of guest address 0
+    size_t committed;       // bytes made accessible
+    uint32_t code_committed;
+    uint32_t map_committed; // bytes of the buffer window made accessible
+    window windows[3];      // data, heap, stack
 
-    mem_rv32i();
+    // Makes [addr, addr + size) accessible; the range may wrap past 4 GiB
+    void commit(uint32_t addr, uint64_t size);
+    // Zeroes [lo, hi), in place from the end a window grows from and by dropping
+    // the pages past CLEAR_LIMIT
+    void clear(uint64_t lo, uint64_t hi, bool down);
+#else
+
+    static constexpr uint32_t L2_BITS = 10;                         // pages per second-level table
+    static constexpr uint32_t L1_SIZE = 1u << (32 - PAGE_BITS - L2_BITS);
+    static constexpr uint32_t TLB_SIZE = 64;
+
+    struct page {
+        std::unique_ptr<uint8_t[]> data;
+        bool dirty;         // written since the last reset()
+        uint8_t* alias;     // host buffer page mapped here instead of data (map_buffer)
+        bool alias_writable;
+    };
+    using page_table = std::unique_ptr<page[]>;
+
+    struct tlb_entry {
+        uint32_t vpn;       // guest page number, ~0 when empty
+        uint8_t* host;
+    };
+
+    page_table directory[L1_SIZE];
+    tlb_entry tlb[TLB_SIZE];
+    tlb_entry write_tlb[TLB_SIZE];  // only holds pages already marked dirty
+    std::vector<uint32_t> dirty_pages;
+    size_t pages_allocated;
+
+    // Host address of the page holding addr, allocating it on first touch
+    uint8_t* host_page(uint32_t addr) {
+        uint32_t vpn = addr >> PAGE_BITS;
+        tlb_entry& e = tlb[vpn & (TLB_SIZE - 1)];
+        if (e.vpn == vpn) {
+            return e.host;
+        }
+        return refill(addr);
+    }
+
+    // Host address of the page holding addr for a store, marking the page dirty
+    uint8_t* writable_page(uint32_t addr) {
+        uint32_t vpn = addr >> PAGE_BITS;
+        tlb_entry& e = write_tlb[vpn & (TLB_SIZE - 1)];
+        if (e.vpn == vpn) {
+            return e.host;
+        }
+        return refill_dirty(addr);
+    }
+
+    page& slot(uint32_t vpn);       // the page entry, without allocating its data
+    page& lookup(uint32_t vpn);
+    void flush_tlbs();
+    uint8_t* refill(uint32_t addr);
+    uint8_t* refill_dirty(uint32_t addr);
+
+    // Accesses that straddle two pages, done a byte at a time
+    uint32_t read_split(uint32_t addr, uint32_t size);
+    void write_split(uint32_t addr, uint32_t val, uint32_t size);
+#endif
+
+    // Guest memory is little-endian; these are no-ops on little-endian hosts
+    static uint16_t le16(uint16_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_bswap16(v);
+#else
+        return v;
+#endif
+    }
+    static uint32_t le32(uint32_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_bswap32(v);
+#else
+        return v;
+#endif
+    }
+
+public:
+    explicit mem_rv32i(const mem_layout& layout = mem_layout());
+    mem_rv32i(const mem_rv32i&) = delete;
+    mem_rv32i& operator=(const mem_rv32i&) = delete;
+#ifdef RV32I_RESERVED_MEMORY
+    ~mem_rv32i();
+#endif
 
     void load_code(const std::vector<uint8_t>& code);
 
+    // Zeroes everything the guest wrote since construction or the last reset, so the
+    // memory can be reused for another call without reallocating it. Code must be
+    // loaded again afterwards.
+    void reset();
+
     // Byte access
     uint8_t read8(uint32_t addr);
     void write8(uint32_t addr, uint8_t val);
@@ -41,12 +204,169 @@ public:
     uint32_t read32(uint32_t addr);
     void write32(uint32_t addr, uint32_t val);
 
+    // Host address of guest addr, with n set to how many of the len bytes from there
+    // are contiguous in host memory; the writable form marks them written
+    uint8_t* span(uint32_t addr, uint32_t len, uint32_t& n);
+    uint8_t* writable_span(uint32_t addr, uint32_t len, uint32_t& n);
+
+    // Bulk operations, done a contiguous span at a time rather than per byte.
+    // move_block handles overlapping ranges like memmove; compare_block returns
+    // -1, 0 or 1 like memcmp.
+    void read_block(uint32_t addr, void* dst, uint32_t len);
+    void write_block(uint32_t addr, const void* src, uint32_t len);
+    void move_block(uint32_t dst, uint32_t src, uint32_t len);
+    void fill_block(uint32_t addr, uint8_t val, uint32_t len);
+    int compare_block(uint32_t a, uint32_t b, uint32_t len);
+    // Bytes before the first zero byte at addr
+    uint32_t string_length(uint32_t addr);
+
+    // Makes size bytes of host memory visible to the guest in the map_start window
+    // and returns their guest address, at the same offset within a page as host.
+    // Paged memory aliases the pages the buffer covers whole, so the guest works on
+    // the buffer itself, and only copies the partial pages at either end; a guest
+    // store to a read-only buffer goes to a private copy of the page. Reserved memory
+    // copies the whole buffer. Throws std::length_error if the window is full.
+    uint32_t map_buffer(void* host, uint32_t size, bool writable);
+    // Copies the guest's changes to the copied parts of writable buffers back and
+    // removes every mapping; call it while the buffers are still alive. reset() also
+    // does this.
+    void unmap_buffers();
+
+    const mem_layout& get_layout() const { return layout; }
     uint32_t get_code_base() const { return code_base; }
     uint32_t get_code_size() const { return code_size; }
     uint32_t get_stack_ptr() const { return stack_ptr; }
     void set_stack_ptr(uint32_t sp) { stack_ptr = sp; }
     uint32_t get_heap_ptr() const { return heap_ptr; }
 
-    size_t get_memory_size() const { return memory.size(); }
+#ifdef RV32I_RESERVED_MEMORY
+    // Bytes of guest memory that are accessible
+    size_t get_memory_size() const { return committed; }
+
+    // For the fault handler: makes the page holding guest address addr accessible
+    // if it lies in the data, heap or stack region, so the access can be retried.
+    // Returns false for any other address. Async-signal-safe.
+    bool grow(uint64_t addr);
+#else
+    // Bytes of guest memory actually backed by host pages
+    size_t get_memory_size() const { return pages_allocated * PAGE_SIZE; }
+#endif
 };
+
+// Accessors are inline so the interpreter and JIT helpers get a single host load or
+// store; memcpy keeps unaligned guest addresses well-defined and compiles to one mov
+#ifdef RV32I_RESERVED_MEMORY
+
+inline uint8_t mem_rv32i::read8(uint32_t addr) {
+    return base[addr];
+}
+
+inline void mem_rv32i::write8(uint32_t addr, uint8_t val) {
+    base[addr] = val;
+}
+
+inline uint16_t mem_rv32i::read16(uint32_t addr) {
+    uint16_t val;
+    std::memcpy(&val, base + addr, sizeof(val));
+    return le16(val);
+}
+
+inline void mem_rv32i::write16(uint32_t addr, uint16_t val) {
+    val = le16(val);
+    std::memcpy(base + addr, &val, sizeof(val));
+}
+
+inline uint32_t mem_rv32i::read32(uint32_t addr) {
+    uint32_t val;
+    std::memcpy(&val, base + addr, sizeof(val));
+    return le32(val);
+}
+
+inline void mem_rv32i::write32(uint32_t addr, uint32_t val) {
+    val = le32(val);
+    std::memcpy(base + addr, &val, sizeof(val));
+}
+
+// Spans run up to the top of the address space, where guest addresses wrap
+inline uint8_t* mem_rv32i::span(uint32_t addr, uint32_t len, uint32_t& n) {
+    n = static_cast<uint32_t>(std::min<uint64_t>(len, (1ull << 32) - addr));
+    return base + addr;
+}
+
+inline uint8_t* mem_rv32i::writable_span(uint32_t addr, uint32_t len, uint32_t& n) {
+    return span(addr, len, n);
+}
+
+#else
+
+inline uint8_t mem_rv32i::read8(uint32_t addr) {
+    return host_page(addr)[addr & PAGE_MASK];
+}
+
+inline void mem_rv32i::write8(uint32_t addr, uint8_t val) {
+    writable_page(addr)[addr & PAGE_MASK] = val;
+}
+
+// A naturally aligned access never straddles a page, so it skips the page-end check
+
+inline uint16_t mem_rv32i::read16(uint32_t addr) {
+    uint16_t val;
+    if (__builtin_expect((addr & 1) == 0, 1)) {
+        std::memcpy(&val, __builtin_assume_aligned(host_page(addr) + (addr & PAGE_MASK), 2), sizeof(val));
+    } else if ((addr & PAGE_MASK) <= PAGE_SIZE - 2) {
+        std::memcpy(&val, host_page(addr) + (addr & PAGE_MASK), sizeof(val));
+    } else {
+        return read_split(addr, 2);
+    }
+    return le16(val);
+}
+
+inline void mem_rv32i::write16(uint32_t addr, uint16_t val) {
+    if (__builtin_expect((addr & 1) == 0, 1)) {
+        val = le16(val);
+        std::memcpy(__builtin_assume_aligned(writable_page(addr) + (addr & PAGE_MASK), 2), &val, sizeof(val));
+    } else if ((addr & PAGE_MASK) <= PAGE_SIZE - 2) {
+        val = le16(val);
+        std::memcpy(writable_page(addr) + (addr & PAGE_MASK), &val, sizeof(val));
+    } else {
+        write_split(addr, val, 2);
+    }
+}
+
+inline uint32_t mem_rv32i::read32(uint32_t addr) {
+    uint32_t val;
+    if (__builtin_expect((addr & 3) == 0, 1)) {
+        std::memcpy(&val, __builtin_assume_aligned(host_page(addr) + (addr & PAGE_MASK), 4), sizeof(val));
+    } else if ((addr & PAGE_MASK) <= PAGE_SIZE - 4) {
+        std::memcpy(&val, host_page(addr) + (addr & PAGE_MASK), sizeof(val));
+    } else {
+        return read_split(addr, 4);
+    }
+    return le32(val);
+}
+
+inline void mem_rv32i::write32(uint32_t addr, uint32_t val) {
+    if (__builtin_expect((addr & 3) == 0, 1)) {
+        val = le32(val);
+        std::memcpy(__builtin_assume_aligned(writable_page(addr) + (addr & PAGE_MASK), 4), &val, sizeof(val));
+    } else if ((addr & PAGE_MASK) <= PAGE_SIZE - 4) {
+        val = le32(val);
+        std::memcpy(writable_page(addr) + (addr & PAGE_MASK), &val, sizeof(val));
+    } else {
+        write_split(addr, val, 4);
+    }
+}
+
+// Spans end at the page boundary
+inline uint8_t* mem_rv32i::span(uint32_t addr, uint32_t len, uint32_t& n) {
+    n = std::min(len, PAGE_SIZE - (addr & PAGE_MASK));
+    return host_page(addr) + (addr & PAGE_MASK);
+}
+
+inline uint8_t* mem_rv32i::writable_span(uint32_t addr, uint32_t len, uint32_t& n) {
+    n = std::min(len, PAGE_SIZE - (addr & PAGE_MASK));
+    return writable_page(addr) + (addr & PAGE_MASK);
+}
+
+#endif
 #endif //MEM_RV32I_H
@@ -0,0 +1,177 @@
+#include "pool_rv32i.h"
+
+#include <algorithm>
+#include <exception>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Worker the current thread is, so calls it submits stay on its own queue
+static thread_local const pool_rv32i* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+void pool_call::wait() {
+    if (ready()) {
+        return;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [this]() { return ready(); });
+}
+
+pool_rv32i::pool_rv32i(unsigned threads, const std::vector<int>& cpus) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned k = 0; k < threads; ++k) {
+        queues.push_back(std::make_unique<queue>());
+        queues.back()->cpu = k < cpus.size() ? cpus[k] : -1;
+    }
+    // Workers start once every queue exists, since they steal from all of them
+    try {
+        for (size_t k = 0; k < queues.size(); ++k) {
+            queues[k]->thread = std::thread(&pool_rv32i::work, this, k);
+        }
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+pool_rv32i::~pool_rv32i() {
+    stop();
+}
+
+void pool_rv32i::stop() {
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::unique_ptr<queue>& q : queues) {
+        if (q->thread.joinable()) {
+            q->thread.join();
+        }
+    }
+}
+
+void pool_rv32i::submit(std::shared_ptr<pool_call> call) {
+    size_t k = current_pool == this ? current_worker
+                                    : deal.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    // Counted before it is queued, so a worker taking it never sees waiting go below 0
+    size_t now = waiting.fetch_add(1) + 1;
+    size_t high = peak.load(std::memory_order_relaxed);
+    while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+    }
+    submit_count.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> guard(queues[k]->lock);
+        queues[k]->calls.push_back(std::move(call));
+    }
+
+    // A worker counts itself asleep before its last look at waiting, so either it
+    // sees this call or it is counted here. Taking the lock then orders the notify
+    // after that look.
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> guard(sleep_lock); }
+        wake.notify_one();
+    }
+}
+
+pool_rv32i::worker_stats pool_rv32i::get_worker_stats(size_t worker) const {
+    const queue& q = *queues.at(worker);
+    worker_stats stats;
+    {
+        std::lock_guard<std::mutex> guard(q.lock);
+        stats.queued = q.calls.size();
+    }
+    stats.completed = q.completed.load(std::memory_order_relaxed);
+    stats.stolen = q.stolen.load(std::memory_order_relaxed);
+    stats.cpu = q.cpu;
+    return stats;
+}
+
+std::shared_ptr<pool_call> pool_rv32i::take(size_t self) {
+    std::shared_ptr<pool_call> call;
+    {
+        queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.calls.empty()) {
+            call = std::move(own.calls.front());
+            own.calls.pop_front();
+        }
+    }
+    for (size_t i = 1; !call && i < queues.size(); ++i) {
+        queue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.calls.empty()) {
+            call = std::move(victim.calls.back());
+            victim.calls.pop_back();
+            queues[self]->stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (call) {
+        waiting.fetch_sub(1);
+    }
+    return call;
+}
+
+void pool_rv32i::work(size_t self) {
+    queue& own = *queues[self];
+#ifdef __linux__
+    if (own.cpu >= 0 && own.cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(own.cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+    current_pool = this;
+    current_worker = self;
+    // Built after pinning, so its guest memory is first touched on the worker's core.
+    // Built on the first call, and retried on later ones if that fails.
+    std::unique_ptr<cpu_rv32i> cpu;
+
+    for (;;) {
+        std::shared_ptr<pool_call> call = take(self);
+        if (!call) {
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            sleepers.fetch_add(1);
+            wake.wait(guard, [this]() { return waiting.load() > 0 || stopping; });
+            sleepers.fetch_sub(1);
+            if (stopping && waiting.load() == 0) {
+                break;
+            }
+            continue;
+        }
+
+        // A call that can't get guest memory fails instead of taking the worker down
+        try {
+            if (!cpu) {
+                cpu = std::make_unique<cpu_rv32i>();
+            }
+            cpu->load_program(call->prog->code);
+            for (size_t i = 0; i < 8; ++i) {
+                cpu->write_reg(10 + i, call->args[i]);
+            }
+            call->result = cpu->execute(*call->prog);
+            if (call->result.reason == EXIT_RETURN) {
+                call->value = cpu->read_reg(10) | (uint64_t)cpu->read_reg(11) << 32;
+            }
+        } catch (const std::exception&) {
+            call->failed = true;
+        }
+        if (cpu) {
+            cpu->reset();
+        }
+        own.completed.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> guard(call->lock);
+            call->done.store(true, std::memory_order_release);
+        }
+        call->finished.notify_all();
+    }
+    current_pool = nullptr;
+}
@@ -0,0 +1,102 @@
+#ifndef POOL_RV32I_H
+#define POOL_RV32I_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu_rv32i.h"
+
+// One submitted invocation and, once a worker has run it, its outcome
+struct pool_call {
+    const prog_rv32i* prog = nullptr;
+    uint32_t args[8] = {};          // a0-a7
+    exec_result result;
+    uint64_t value = 0;             // a0 (low) and a1 (high) when the guest returned
+    bool failed = false;            // the worker could not set up guest memory, nothing ran
+
+    // Blocks until a worker has run the call
+    void wait();
+    bool ready() const { return done.load(std::memory_order_acquire); }
+
+private:
+    friend class pool_rv32i;
+    std::atomic<bool> done{false};
+    std::mutex lock;
+    std::condition_variable finished;
+};
+
+// Work-stealing pool of worker threads running guest invocations asynchronously.
+// Each worker owns a cpu_rv32i, built on the worker's own thread (and core, when
+// pinned) and reset between calls, and a queue of calls. Submissions from outside
+// the pool are dealt round-robin over the queues, a call submitted from a worker
+// (by a host call) goes on that worker's own queue. A worker runs its queue oldest
+// first and, once it is empty, steals the newest call from another worker's.
+class pool_rv32i {
+public:
+    struct worker_stats {
+        size_t queued = 0;          // calls waiting in this worker's queue
+        uint64_t completed = 0;     // calls this worker ran
+        uint64_t stolen = 0;        // of those, taken from another worker's queue
+        int cpu = -1;               // host CPU the worker is pinned to, or -1
+    };
+
+    // threads workers (0 for one per hardware thread); worker k is pinned to host
+    // CPU cpus[k] if cpus has an entry for it that isn't -1. Pinning is skipped on
+    // hosts without thread affinity.
+    explicit pool_rv32i(unsigned threads = 0, const std::vector<int>& cpus = {});
+
+    // Runs the calls still queued, then stops the workers
+    ~pool_rv32i();
+
+    pool_rv32i(const pool_rv32i&) = delete;
+    pool_rv32i& operator=(const pool_rv32i&) = delete;
+
+    // Queues call; prog must stay alive until it has run. A host call running on a
+    // worker must not wait for a call it submitted, which may be queued behind it.
+    void submit(std::shared_ptr<pool_call> call);
+
+    size_t workers() const { return queues.size(); }
+    worker_stats get_worker_stats(size_t worker) const;
+
+    uint64_t submitted() const { return submit_count.load(std::memory_order_relaxed); }
+    size_t queued() const { return waiting.load(std::memory_order_relaxed); }
+    // Most calls ever waiting at once
+    size_t peak_queued() const { return peak.load(std::memory_order_relaxed); }
+
+private:
+    struct queue {
+        mutable std::mutex lock;
+        std::deque<std::shared_ptr<pool_call>> calls;
+        std::atomic<uint64_t> completed{0};
+        std::atomic<uint64_t> stolen{0};
+        int cpu = -1;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::atomic<size_t> waiting{0};     // calls queued and not yet taken
+    std::atomic<size_t> peak{0};
+    std::atomic<uint64_t> submit_count{0};
+    std::atomic<size_t> deal{0};        // round-robin position for outside submissions
+
+    // Idle workers sleep here until a call is queued or the pool stops
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    std::atomic<unsigned> sleepers{0};  // workers waiting on wake
+    bool stopping = false;
+
+    void work(size_t self);
+    // Lets the workers drain their queues and joins them
+    void stop();
+    // Next call for worker self: its own oldest, else another worker's newest
+    std::shared_ptr<pool_call> take(size_t self);
+};
+
+#endif //POOL_RV32I_H
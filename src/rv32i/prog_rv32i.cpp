@@ -0,0 +1,218 @@
+#include "prog_rv32i.h"
+#include "batch_rv32i.h"
+#include "../obf/restore.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+prog_rv32i::prog_rv32i(const uint8_t* bytecode, size_t size, bool obfuscated)
+    : code(bytecode, bytecode + size) {
+    if (code.size() % 2 != 0) {
+        throw std::runtime_error("Binary size is not a multiple of 2");
+    }
+    if (obfuscated) {
+        deobfuscate(code);
+    }
+
+    // Words that don't decode (data mixed into the code) become INVALID and only
+    // trap if execution reaches them
+    decoded.resize(code.size() / 2 + 1);
+    offsets.resize(code.size() / 2 + 1);
+    size_t count = decodeProgram(code.data(), code.size(), decoded.data(), offsets.data());
+    decoded.resize(count + 1);
+    decoded.shrink_to_fit();
+    offsets.resize(count + 1);
+    offsets.shrink_to_fit();
+
+    // Running off the end lands here instead of past the array
+    decoded.back() = {INVALID, 0, 0, 0, 0};
+    offsets.back() = static_cast<uint32_t>(code.size());
+    index_of.assign(code.size() / 2 + 1, NO_INSTRUCTION);
+    for (size_t n = 0; n < decoded.size(); n++) {
+        index_of[offsets[n] / 2] = static_cast<uint32_t>(n);
+    }
+    resolve_targets();
+    fuse();
+    block_starts.reset(new std::atomic<block_rv32i*>[decoded.size()]);
+    for (size_t i = 0; i < decoded.size(); i++) {
+        block_starts[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+// Resolves the pc-relative target of every JAL and branch. Offsets are relative to
+// the instruction, so the result holds for any code base.
+void prog_rv32i::resolve_targets() {
+    targets.assign(decoded.size(), 0);
+    for (size_t n = 0; n < decoded.size(); n++) {
+        switch (decoded[n].op) {
+            case JAL: case BEQ: case BNE: case BLT: case BGE: case BLTU: case BGEU:
+                break;
+            default:
+                continue;
+        }
+        int64_t offset = static_cast<int64_t>(offsets[n]) + decoded[n].imm;
+        if (offset < 0) {
+            targets[n] = TARGET_UNDERFLOW;
+        } else if (offset % 2 != 0) {
+            targets[n] = TARGET_MISALIGNED;
+        } else if (static_cast<uint64_t>(offset / 2) >= index_of.size()) {
+            targets[n] = TARGET_OVERFLOW;
+        } else if (index_of[offset / 2] == NO_INSTRUCTION) {
+            targets[n] = TARGET_MISALIGNED;
+        } else {
+            targets[n] = index_of[offset / 2];
+        }
+    }
+}
+
+const char* fusion_idiom_name(FUSION_IDIOM idiom) {
+    switch (idiom) {
+        case FUSION_LUI_ADDI: return "LUI+ADDI";
+        case FUSION_AUIPC_JALR: return "AUIPC+JALR";
+        case FUSION_LOAD_ALU: return "LW+ALU";
+        case FUSION_COMPARE_BRANCH: return "SLT(U)+BEQ/BNE";
+        default: return "unknown";
+    }
+}
+
+// The fused op for a followed by b, or a's own op if the pair is not an idiom.
+// Each idiom needs b to consume the register a writes.
+static uint8_t fused_op(const DecodedInst& a, const DecodedInst& b) {
+    if (a.rd == 0) {
+        return a.op;
+    }
+    switch (a.op) {
+        case LUI:
+            if (b.op == ADDI && b.rs1 == a.rd) return FUSED_LUI_ADDI;
+            break;
+        case AUIPC:
+            if (b.op == JALR && b.rs1 == a.rd) return FUSED_AUIPC_JALR;
+            break;
+        case LW:
+            if (b.op == ADDI && b.rs1 == a.rd) return FUSED_LW_ADDI;
+            if (b.op == ADD && (b.rs1 == a.rd || b.rs2 == a.rd)) return FUSED_LW_ADD;
+            if (b.op == SUB && (b.rs1 == a.rd || b.rs2 == a.rd)) return FUSED_LW_SUB;
+            break;
+        case SLT:
+        case SLTU:
+            // beqz/bnez on the result
+            if ((b.op == BEQ || b.op == BNE) && b.rs1 == a.rd && b.rs2 == 0) {
+                if (a.op == SLT) return b.op == BEQ ? FUSED_SLT_BEQ : FUSED_SLT_BNE;
+                return b.op == BEQ ? FUSED_SLTU_BEQ : FUSED_SLTU_BNE;
+            }
+            break;
+        default:
+            break;
+    }
+    return a.op;
+}
+
+static FUSION_IDIOM idiom_of(uint8_t op) {
+    switch (op) {
+        case FUSED_LUI_ADDI: return FUSION_LUI_ADDI;
+        case FUSED_AUIPC_JALR: return FUSION_AUIPC_JALR;
+        case FUSED_LW_ADDI: case FUSED_LW_ADD: case FUSED_LW_SUB: return FUSION_LOAD_ALU;
+        default: return FUSION_COMPARE_BRANCH;
+    }
+}
+
+void prog_rv32i::fuse(bool enable) {
+    ops.resize(decoded.size());
+    std::fill(std::begin(fusion_sites), std::end(fusion_sites), 0);
+    for (size_t n = 0; n < decoded.size(); n++) {
+        ops[n] = decoded[n].op;
+        // The stop word never fuses, so n + 1 stays in range
+        if (enable && n + 1 < decoded.size()) {
+            uint8_t op = fused_op(decoded[n], decoded[n + 1]);
+            if (op != decoded[n].op) {
+                ops[n] = op;
+                fusion_sites[idiom_of(op)]++;
+                // Pairs don't overlap: the second instruction keeps its own op
+                ops[n + 1] = decoded[n + 1].op;
+                n++;
+            }
+        }
+    }
+}
+
+// Instructions that leave straight-line execution
+static bool ends_block(uint8_t op) {
+    switch (op) {
+        case JAL: case JALR: case RET:
+        case BEQ: case BNE: case BLT: case BGE: case BLTU: case BGEU:
+        case ECALL: case EBREAK: case INVALID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+block_rv32i* prog_rv32i::block_at(size_t index) const {
+    block_rv32i* blk = block_starts[index].load(std::memory_order_acquire);
+    if (blk) {
+        return blk;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    blk = block_starts[index].load(std::memory_order_relaxed);
+    if (blk) {
+        return blk;     // another thread built it first
+    }
+
+    // The stop word always ends a block, so this stays in range
+    size_t end = index;
+    while (!ends_block(decoded[end].op)) {
+        end++;
+    }
+
+    blk = &blocks.emplace_back();
+    blk->start = static_cast<uint32_t>(index);
+    blk->length = static_cast<uint32_t>(end - index + 1);
+    block_starts[index].store(blk, std::memory_order_release);
+    return blk;
+}
+
+native_block_fn prog_rv32i::native_code(block_rv32i* blk, uint32_t code_base) const {
+#ifdef RV32I_JIT_X86_64
+    native_block_fn native = blk->native.load(std::memory_order_acquire);
+    if (native) {
+        return native_base == code_base ? native : nullptr;
+    }
+
+    // Translation is attempted by whichever caller brings the count to the
+    // threshold. Concurrent callers may drop an increment, which only delays it, or
+    // both reach the threshold, in which case the second finds the first's code.
+    uint32_t count = blk->exec_count.load(std::memory_order_relaxed);
+    if (jit_threshold == 0 || count >= jit_threshold) {
+        return nullptr;
+    }
+    blk->exec_count.store(++count, std::memory_order_relaxed);
+    if (count < jit_threshold) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    native = blk->native.load(std::memory_order_acquire);
+    if (native) {
+        // Translated while this caller waited; native_length must not be rewritten
+        // under a thread already running it
+        return native_base == code_base ? native : nullptr;
+    }
+    if (!jit) {
+        jit = std::make_unique<jit_x86_64>();
+        native_base = code_base;
+    }
+    if (native_base != code_base) {
+        return nullptr;
+    }
+    size_t translated = 0;
+    native = jit->compile(&decoded[blk->start], &offsets[blk->start], blk->length, code_base, blk->start, translated);
+    blk->native_length = static_cast<uint32_t>(translated);
+    blk->native.store(native, std::memory_order_release);
+    return native;
+#else
+    (void)blk;
+    (void)code_base;
+    return nullptr;
+#endif
+}
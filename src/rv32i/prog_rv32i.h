@@ -0,0 +1,150 @@
+#ifndef PROG_RV32I_H
+#define PROG_RV32I_H
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dis_rv32i.h"
+#include "host_rv32i.h"
+#include "jit_x86_64.h"
+
+#ifndef RV32I_JIT_THRESHOLD
+#define RV32I_JIT_THRESHOLD 1000
+#endif
+
+// Superinstructions. Predecode rewrites the dispatch op of the first instruction of
+// a common -O0 pair to one of these, and its handler runs both instructions in one
+// dispatch. The second instruction keeps its own slot and op, so indices still map
+// 1:1 to guest instructions and a jump into the middle of a pair runs it on its own.
+enum FUSED_OP {
+    FUSED_LUI_ADDI = MNEMONIC_COUNT,    // 32-bit constant
+    FUSED_AUIPC_JALR,                   // pc-relative call
+    FUSED_LW_ADDI,                      // load feeding an ALU op
+    FUSED_LW_ADD,
+    FUSED_LW_SUB,
+    FUSED_SLT_BEQ,                      // comparison tested against zero
+    FUSED_SLT_BNE,
+    FUSED_SLTU_BEQ,
+    FUSED_SLTU_BNE,
+    DISPATCH_OP_COUNT
+};
+
+// Idioms the fused ops belong to, for hit counts
+enum FUSION_IDIOM { FUSION_LUI_ADDI, FUSION_AUIPC_JALR, FUSION_LOAD_ALU, FUSION_COMPARE_BRANCH, FUSION_IDIOM_COUNT };
+
+const char* fusion_idiom_name(FUSION_IDIOM idiom);
+
+// Where a static jump or branch lands when its target is outside the program;
+// anything below these in `prog_rv32i::targets` is a valid instruction index
+enum TARGET_TRAP : uint32_t {
+    TARGET_UNDERFLOW = 0xFFFFFFF0,  // before the first instruction
+    TARGET_MISALIGNED,              // not at the start of an instruction
+    TARGET_OVERFLOW                 // past the stop word
+};
+
+// Basic block: a straight-line run of decoded instructions ending in a control
+// transfer (jump, branch, RET, ECALL/EBREAK or the stop word). Successor links are
+// filled in the first time an edge is taken, so later transitions skip pc validation.
+// A link is a single atomic pointer and is valid for a target when the linked block
+// starts there, so callers on other threads never see a half-updated link. Edges of
+// JAL and branches have a single target, so their links are valid once set.
+struct block_rv32i {
+    using link = std::atomic<block_rv32i*>;
+
+    uint32_t start = 0;     // index of the first instruction
+    uint32_t length = 0;    // instructions in the block, terminator included
+    link taken{nullptr};    // jump/branch target (last target seen for JALR)
+    link next{nullptr};     // fall-through successor of a conditional branch
+
+    std::atomic<uint32_t> exec_count{0};        // entries, counted up to the JIT threshold
+    uint32_t native_length = 0;                 // leading instructions covered by native code
+    std::atomic<native_block_fn> native{nullptr};   // JIT translation, once the block is hot
+};
+
+// A restored and decoded RV32I program, prepared once and reused across calls.
+// The decoded program never changes after construction; the lazily built state
+// (handler table, blocks, links, JIT code) is published with atomics and built under
+// `lock`, so one program can be executed from any number of threads at once.
+class prog_rv32i {
+public:
+    static constexpr uint32_t NO_INSTRUCTION = UINT32_MAX;
+
+    std::vector<uint8_t> code;          // restored code bytes
+    std::vector<DecodedInst> decoded;   // one per instruction plus a trailing INVALID stop word;
+                                        // RV32C instructions are stored expanded
+
+    // Byte offset of each decoded instruction from the code base; the stop word's is
+    // code.size(). Instructions are 2 or 4 bytes, so pcs come from here, not the index.
+    std::vector<uint32_t> offsets;
+    // Index of the instruction starting at each halfword of the code (and at its end,
+    // the stop word), NO_INSTRUCTION inside a 4-byte instruction
+    std::vector<uint32_t> index_of;
+
+    // Op the interpreter dispatches on per decoded instruction: its mnemonic, or a
+    // FUSED_OP when it starts a fused pair. The JIT works from `decoded` alone.
+    std::vector<uint8_t> ops;
+
+    // Static target of each JAL and branch, resolved to an instruction index (or a
+    // TARGET_TRAP) at predecode; zero for other instructions. Only JALR targets are
+    // validated at run time.
+    std::vector<uint32_t> targets;
+    uint32_t fusion_sites[FUSION_IDIOM_COUNT] = {};                 // pairs fused, per idiom
+    mutable std::atomic<uint64_t> fusion_hits[FUSION_IDIOM_COUNT] = {};    // fused pairs executed
+
+    // Host calls (by a7 number) the program's ECALLs may make; none unless allowed.
+    // Set them before the program is first executed.
+    std::bitset<HOST_CALL_COUNT> host_calls;
+
+    // Threaded-dispatch handler address per decoded instruction, filled in once by
+    // the interpreter on first execution (see cpu_rv32i::execute)
+    mutable std::vector<const void*> handlers;
+    mutable std::once_flag handlers_once;
+
+    // Guards building blocks and JIT translation; also hold it to walk `blocks`
+    mutable std::mutex lock;
+
+    // Basic blocks built as execution first reaches them, and chaining counters
+    mutable std::deque<block_rv32i> blocks;
+    std::unique_ptr<std::atomic<block_rv32i*>[]> block_starts;    // block starting at each index, if built
+    mutable std::atomic<uint64_t> block_transitions{0};
+    mutable std::atomic<uint64_t> chain_hits{0};
+
+    // Block entries before a block is handed to the JIT, 0 keeps everything
+    // interpreted. Set it before the program is first executed.
+    uint32_t jit_threshold = RV32I_JIT_THRESHOLD;
+    mutable std::unique_ptr<jit_x86_64> jit;
+    mutable uint32_t native_base = 0;   // code base the JIT translated for
+
+    // Restores (if obfuscated) and decodes the bytecode, which may mix RV32C and
+    // 32-bit instructions; throws if the size is odd
+    prog_rv32i(const uint8_t* bytecode, size_t size, bool obfuscated = true);
+
+    // Rebuilds `ops`, fusing pairs unless disabled (the constructor fuses). Call it
+    // before the program is first executed.
+    void fuse(bool enable = true);
+
+    // Number of real instructions (excludes the stop word)
+    size_t instruction_count() const { return decoded.size() - 1; }
+
+    // Guest address of the instruction at index
+    uint32_t pc_of(size_t index, uint32_t code_base) const { return code_base + offsets[index]; }
+
+    // Returns the block starting at index, splitting it off on first use
+    block_rv32i* block_at(size_t index) const;
+
+    // Counts an entry into blk, translating it once it reaches jit_threshold, and
+    // returns its native code if it has any. Native code has guest addresses baked
+    // in, so it is only returned for the code base it was translated for. Always
+    // nullptr without RV32I_JIT_X86_64.
+    native_block_fn native_code(block_rv32i* blk, uint32_t code_base) const;
+
+private:
+    void resolve_targets();
+};
+
+#endif //PROG_RV32I_H
@@ -0,0 +1,5 @@
+#ifndef DIV_OP_H
+#define DIV_OP_H
+#include <stdint.h>
+int32_t div_op(int32_t a, int32_t b);
+#endif
@@ -0,0 +1,5 @@
+#include <stdint.h>
+int mulh(int a, int b) {
+  int64_t p = (int64_t)a * (int64_t)b;
+  return (int)(p >> 32);
+}
@@ -0,0 +1,5 @@
+#ifndef MULH_H
+#define MULH_H
+#include <stdint.h>
+int32_t mulh(int32_t a, int32_t b);
+#endif
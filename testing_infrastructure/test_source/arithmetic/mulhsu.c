@@ -0,0 +1,6 @@
+#include <stdint.h>
+// b is taken as unsigned, so -1 stands for 0xffffffff
+int mulhsu(int a, int b) {
+  int64_t p = (int64_t)a * (int64_t)(uint32_t)b;
+  return (int)(p >> 32);
+}
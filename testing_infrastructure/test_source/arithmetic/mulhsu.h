@@ -0,0 +1,5 @@
+#ifndef MULHSU_H
+#define MULHSU_H
+#include <stdint.h>
+int32_t mulhsu(int32_t a, int32_t b);
+#endif
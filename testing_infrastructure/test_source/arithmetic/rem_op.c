@@ -0,0 +1,14 @@
+#include <stdint.h>
+// RISC-V defines the cases C leaves undefined: x % 0 is x and
+// INT32_MIN % -1 is 0. The native build spells them out.
+int rem_op(int a, int b) {
+#if defined(__riscv)
+  int r;
+  __asm__("rem %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+#else
+  if (b == 0) return a;
+  if (a == INT32_MIN && b == -1) return 0;
+  return a % b;
+#endif
+}
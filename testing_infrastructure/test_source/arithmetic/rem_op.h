@@ -0,0 +1,5 @@
+#ifndef REM_OP_H
+#define REM_OP_H
+#include <stdint.h>
+int32_t rem_op(int32_t a, int32_t b);
+#endif
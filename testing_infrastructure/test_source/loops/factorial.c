@@ -0,0 +1,5 @@
+#include <stdint.h>
+int factorial(int a, int b) {
+  if (a <= 1) return 1;
+  return a * factorial(a - 1, b);
+}
@@ -0,0 +1,5 @@
+#ifndef FACTORIAL_H
+#define FACTORIAL_H
+#include <stdint.h>
+int32_t factorial(int32_t a, int32_t b);
+#endif
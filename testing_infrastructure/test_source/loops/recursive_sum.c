@@ -0,0 +1,7 @@
+#include <stdint.h>
+// Sums a down to 0 one call deep per step, so a above 64 recurses past the
+// emulator's return-address cache
+int recursive_sum(int a, int b) {
+  if (a <= 0) return b;
+  return a + recursive_sum(a - 1, b);
+}
@@ -0,0 +1,5 @@
+#ifndef RECURSIVE_SUM_H
+#define RECURSIVE_SUM_H
+#include <stdint.h>
+int32_t recursive_sum(int32_t a, int32_t b);
+#endif
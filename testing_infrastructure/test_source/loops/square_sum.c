@@ -0,0 +1,14 @@
+#include <stdint.h>
+// Calls a helper, so with compressed code the return address can sit at a 2-byte
+// offset. The helper comes after square_sum, which must start the .text section.
+static int square(int x);
+
+int square_sum(int a, int b) {
+  int sum = 0;
+  for (int i = 0; i < b; i++) {
+    sum += square(a + i);
+  }
+  return sum;
+}
+
+static int square(int x) { return x * x; }
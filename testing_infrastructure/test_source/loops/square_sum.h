@@ -0,0 +1,5 @@
+#ifndef SQUARE_SUM_H
+#define SQUARE_SUM_H
+#include <stdint.h>
+int32_t square_sum(int32_t a, int32_t b);
+#endif
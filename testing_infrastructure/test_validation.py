@@ -4,6 +4,7 @@ import sys
 import yaml
 import shutil
 import re
+import struct
 import time
 from typing import List, Dict, Any, Optional, Tuple
 
@@ -19,6 +20,20 @@ CAPSTONE_SCRIPT = os.path.join(TESTING_INFRA, "testing_utils", "capstone_disasm.
 UNICORN_SCRIPT = os.path.join(TESTING_INFRA, "testing_utils", "unicorn_test_harness.py")
 TEST_ARTIFACTS_DIR = os.path.join(BUILD_DIR, "test_artifacts")
 
+# ISA the target functions are compiled for: Unicorn, the reference, has no Zba/Zbb.
+# A test can set its own with an arch key.
+DEFAULT_ARCH = "rv32imc"
+
+
+def guest_memory_backend() -> str:
+    """The RV32I_MEMORY backend execrv32i was configured with (paged unless set)."""
+    try:
+        with open(os.path.join(BUILD_DIR, "CMakeCache.txt")) as f:
+            match = re.search(r"^RV32I_MEMORY:\w+=(\w+)$", f.read(), re.MULTILINE)
+    except OSError:
+        return "paged"
+    return match.group(1) if match else "paged"
+
 os.makedirs(TEST_ARTIFACTS_DIR, exist_ok=True)
 
 
@@ -32,6 +47,7 @@ class TestScenario:
         self.test_main = os.path.join(self.test_dir, config["test_main"])
         self.fn_name = config["fn_name"]
         self.args = [str(a) for a in config.get("args", [])]
+        self.arch = config.get("arch", DEFAULT_ARCH)
 
         self.out_dir = os.path.join(TEST_ARTIFACTS_DIR, self.test_name)
 
@@ -48,6 +64,7 @@ class TestScenario:
         self.time_unicorn = 0.0
         self.time_emu_non_obf = 0.0
         self.time_emu_obf_tool = 0.0
+        self.time_emu_jit_lanes = 0.0
         self.time_obf_binary = 0.0
 
     def setup(self):
@@ -76,7 +93,8 @@ class TestScenario:
             "--func-impl", self.source_file,
             "--func-header", self.source_header,
             "--output-name", self.obf_exe_name,
-            "--output-dir", self.out_dir
+            "--output-dir", self.out_dir,
+            "--arch", self.arch
         ]
         subprocess.check_call(cmd_obf, cwd=DIST_DIR, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
 
@@ -162,7 +180,7 @@ class TestScenario:
             proc_emu_non_obf = subprocess.run([EXECRV32I, "emu", self.target_rv32i] + self.args, capture_output=True,
                                               text=True, check=True)
             self.time_emu_non_obf = time.perf_counter() - start
-            emu_non_obf_res = int(proc_emu_non_obf.stdout.strip())
+            emu_non_obf_res = self._to_signed_32(int(proc_emu_non_obf.stdout.strip()))
         except Exception as e:
             print(f"    Emulator (Non-Obf) Execution: \033[91mFAIL\033[0m ({e})")
             return False
@@ -175,11 +193,27 @@ class TestScenario:
             self.time_emu_obf_tool = time.perf_counter() - start
             output_lines = [line for line in proc_emu_obf_tool.stdout.splitlines() if
                             "Deobfuscated input file" not in line]
-            emu_obf_tool_res = int(output_lines[-1].strip()) if output_lines else 0
+            emu_obf_tool_res = self._to_signed_32(int(output_lines[-1].strip())) if output_lines else 0
         except Exception as e:
             print(f"    Emulator (Obf Tool) Execution: \033[91mFAIL\033[0m ({e})")
             return False
 
+        # Emulator (JIT and Lockstep): translates every block on first use and reruns the
+        # call on the lockstep lanes, which fails if they disagree with the scalar result
+        try:
+            start = time.perf_counter()
+            proc_emu_jit_lanes = subprocess.run([EXECRV32I, "bench", "--jit-threshold", "1", "--lanes",
+                                                 "--iterations", "8", self.target_rv32i] + self.args,
+                                                capture_output=True, text=True, check=True)
+            self.time_emu_jit_lanes = time.perf_counter() - start
+            match = re.search(r"Result:\s+(\d+)", proc_emu_jit_lanes.stdout)
+            if not match:
+                raise RuntimeError(f"Could not parse bench output: {proc_emu_jit_lanes.stdout}")
+            emu_jit_lanes_res = self._to_signed_32(int(match.group(1)))
+        except Exception as e:
+            print(f"    Emulator (JIT, Lockstep) Execution: \033[91mFAIL\033[0m ({e})")
+            return False
+
         # Obfuscated Binary
         try:
             start = time.perf_counter()
@@ -207,6 +241,13 @@ class TestScenario:
                 f"    Emulator (Non-Obf) vs Unicorn: \033[91mFAIL\033[0m (Emu: {emu_non_obf_res}, Unicorn: {uni_res})")
             passed = False
 
+        if emu_jit_lanes_res == uni_res:
+            print("    Emulator (JIT, Lockstep) vs Unicorn: \033[92mPass\033[0m")
+        else:
+            print(
+                f"    Emulator (JIT, Lockstep) vs Unicorn: \033[91mFAIL\033[0m (Emu: {emu_jit_lanes_res}, Unicorn: {uni_res})")
+            passed = False
+
         if emu_obf_tool_res == native_res:
             print("    Emulator (Obf Tool) vs Native: \033[92mPass\033[0m")
         else:
@@ -268,6 +309,88 @@ class TestScenario:
         return passed
 
 
+class InstructionScenario:
+    """Runs hand-encoded instructions the reference can't, checking a0 against expect,
+    or for expect_error that the call fails with that message. A test with a memory
+    key only runs against that guest memory backend.
+
+    A test with lanes also runs one lockstep group, each lane with its own args, which
+    bench checks against scalar calls; expect_lanes gives each lane's a0, or the error
+    a faulting lane stops with."""
+
+    # Interpreter only, then the JIT translating every block with the lockstep lanes rerunning the call
+    MODES = [("Interpreter", ["--jit-threshold", "0"]),
+             ("JIT, Lockstep", ["--jit-threshold", "1", "--lanes"])]
+
+    def __init__(self, config: Dict[str, Any]):
+        self.test_name = config["test_name"]
+        self.code = [int(w) for w in config["code"]]
+        self.args = [str(a) for a in config.get("args", [])]
+        self.expect = int(config.get("expect", 0)) & 0xFFFFFFFF
+        self.expect_error = config.get("expect_error")
+        self.memory = config.get("memory")
+        self.lanes = [[str(a) for a in lane] for lane in config.get("lanes", [])]
+        self.expect_lanes = config.get("expect_lanes", [])
+        self.out_dir = os.path.join(TEST_ARTIFACTS_DIR, self.test_name)
+        self.target_rv32i = os.path.join(self.out_dir, "target_fn.rv32i")
+
+    def run(self):
+        print(f"Running {self.test_name}...")
+        if self.memory and self.memory != guest_memory_backend():
+            print(f"    Skipped (needs RV32I_MEMORY={self.memory})")
+            return True
+        if os.path.exists(self.out_dir):
+            shutil.rmtree(self.out_dir)
+        os.makedirs(self.out_dir)
+        with open(self.target_rv32i, "wb") as f:
+            f.write(struct.pack(f"<{len(self.code)}I", *self.code))
+
+        passed = True
+        lane_options = ["--lane-args", ";".join(",".join(lane) for lane in self.lanes)] if self.lanes else []
+        for mode, options in self.MODES:
+            try:
+                proc = subprocess.run([EXECRV32I, "bench"] + options + lane_options
+                                      + ["--iterations", "8", self.target_rv32i]
+                                      + self.args, capture_output=True, text=True, check=not self.expect_error)
+                if self.expect_error:
+                    if proc.returncode != 0 and self.expect_error in proc.stderr:
+                        print(f"    Emulator ({mode}): \033[92mPass\033[0m")
+                    else:
+                        print(f"    Emulator ({mode}): \033[91mFAIL\033[0m (expected \"{self.expect_error}\", "
+                              f"got: {(proc.stderr or proc.stdout).strip()})")
+                        passed = False
+                    continue
+                match = re.search(r"Result:\s+(\d+)", proc.stdout)
+                if not match:
+                    raise RuntimeError(f"Could not parse bench output: {proc.stdout}")
+                result = int(match.group(1))
+                lanes = dict(re.findall(r"^Lane (\d+):\s+(.*)$", proc.stdout, re.MULTILINE))
+                wrong_lanes = [n for n, expected in enumerate(self.expect_lanes)
+                               if not self._lane_matches(lanes.get(str(n)), expected)]
+            except Exception as e:
+                print(f"    Emulator ({mode}) Execution: \033[91mFAIL\033[0m ({e})")
+                passed = False
+                continue
+            if result != self.expect:
+                print(f"    Emulator ({mode}): \033[91mFAIL\033[0m (Emu: 0x{result:08x}, Expected: 0x{self.expect:08x})")
+                passed = False
+            elif wrong_lanes:
+                print(f"    Emulator ({mode}): \033[91mFAIL\033[0m (lane {wrong_lanes[0]}: "
+                      f"{lanes.get(str(wrong_lanes[0]))}, Expected: {self.expect_lanes[wrong_lanes[0]]})")
+                passed = False
+            else:
+                print(f"    Emulator ({mode}): \033[92mPass\033[0m")
+        return passed
+
+    @staticmethod
+    def _lane_matches(output: Optional[str], expected: Any) -> bool:
+        if output is None:
+            return False
+        if isinstance(expected, int):
+            return output.isdigit() and int(output) == expected & 0xFFFFFFFF
+        return str(expected) in output
+
+
 class TestRunner:
     def __init__(self):
         self.config = {}
@@ -304,8 +427,9 @@ class TestRunner:
         self.setup_environment()
 
         tests_cfg = self.config.get("tests", [])
+        instruction_cfg = self.config.get("instruction_tests", [])
         passed = 0
-        total = len(tests_cfg)
+        total = len(tests_cfg) + len(instruction_cfg)
 
         print(f"\nRunning {total} tests...\n")
 
@@ -316,6 +440,11 @@ class TestRunner:
                 passed += 1
             print("-" * 40)
 
+        for test_cfg in instruction_cfg:
+            if InstructionScenario(test_cfg).run():
+                passed += 1
+            print("-" * 40)
+
         self.print_profiling_report()
 
         print(f"Summary: {passed}/{total} tests passed.")
@@ -19,7 +19,10 @@ def main():
         print(f"Error: Could not open {filename}")
         sys.exit(1)
 
-    md = Cs(CS_ARCH_RISCV, CS_MODE_RISCV32)
+    # Targets are built with the C extension; the mode is CS_MODE_RISCVC or
+    # CS_MODE_RISCV_C depending on the capstone release
+    compressed = globals().get("CS_MODE_RISCVC", globals().get("CS_MODE_RISCV_C", 0))
+    md = Cs(CS_ARCH_RISCV, CS_MODE_RISCV32 | compressed)
 
     if not args.onlyasm:
         print(f"{'Addr':<10} {'Raw Hex':<12} {'Instruction'}")
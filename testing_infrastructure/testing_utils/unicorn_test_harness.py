@@ -94,7 +94,7 @@ def test_rv32i_function(binary_path, args=None, verbose=False):
     ]
 
     for i, arg in enumerate(args[:8]):
-        mu.reg_write(arg_regs[i], int(arg))
+        mu.reg_write(arg_regs[i], int(arg) & 0xFFFFFFFF)
         if verbose:
             print(f"Set a{i} (x{10 + i}) = {arg}")
 